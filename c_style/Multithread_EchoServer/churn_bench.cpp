@@ -0,0 +1,133 @@
+//短连接压测：多个客户端线程循环"连接 → 发一条消息 → 收回声 → 关闭"，统计每秒完成的连接数
+//用来对比 server 的三种线程模型（见 run_churn_bench.sh）
+//用法：churn_bench [--clients=并发数] [--seconds=秒数] [--size=消息字节数]
+#include<iostream>
+#include<vector>
+#include<algorithm>
+#include<pthread.h>
+#include<unistd.h>
+#include<sys/socket.h>
+#include<netinet/in.h>
+#include<netinet/tcp.h>
+#include<arpa/inet.h>
+#include<string.h>
+#include<stdlib.h>
+#include<errno.h>
+#include<time.h>
+
+#define PORT 8080
+
+struct ClientStats {
+    pthread_t tid;
+    std::vector<double> latencies_us;  //每个连接从 connect 到收完回声的时间
+    long failures=0;                   //connect/收发失败次数
+};
+
+static int g_clients=32;
+static int g_seconds=5;
+static int g_size=32;
+static volatile bool g_stop=false;
+
+double now_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec*1e6+ts.tv_nsec/1e3;
+}
+
+//一次完整的短连接，成功返回 true
+bool one_connection(const char *message,char *reply) {
+    int fd=socket(AF_INET,SOCK_STREAM,0);
+    if(fd<0) {
+        return false;
+    }
+    struct sockaddr_in serv_addr{};
+    serv_addr.sin_family=AF_INET;
+    serv_addr.sin_port=htons(PORT);
+    inet_pton(AF_INET,"127.0.0.1",&serv_addr.sin_addr);
+    int opt=1;
+    setsockopt(fd,IPPROTO_TCP,TCP_NODELAY,&opt,sizeof(opt));
+
+    bool ok=connect(fd,(sockaddr*)&serv_addr,sizeof(serv_addr))==0&&
+            send(fd,message,g_size,MSG_NOSIGNAL)==g_size;
+    int received=0;
+    while(ok&&received<g_size) {
+        ssize_t n=read(fd,reply+received,g_size-received);
+        if(n<=0) {
+            ok=false;
+            break;
+        }
+        received+=n;
+    }
+    close(fd);
+    return ok;
+}
+
+void *client_thread(void *arg) {
+    ClientStats *stats=(ClientStats*)arg;
+    char *message=(char*)malloc(g_size);
+    char *reply=(char*)malloc(g_size);
+    memset(message,'x',g_size);
+    message[g_size-1]='\n';
+    while(!g_stop) {
+        double start=now_us();
+        if(one_connection(message,reply)) {
+            stats->latencies_us.push_back(now_us()-start);
+        } else {
+            ++stats->failures;
+        }
+    }
+    free(message);
+    free(reply);
+    return nullptr;
+}
+
+int main(int argc,char *argv[]) {
+    for(int i=1;i<argc;++i) {
+        const char *arg=argv[i];
+        if(strncmp(arg,"--clients=",10)==0&&atoi(arg+10)>0) {
+            g_clients=atoi(arg+10);
+        } else if(strncmp(arg,"--seconds=",10)==0&&atoi(arg+10)>0) {
+            g_seconds=atoi(arg+10);
+        } else if(strncmp(arg,"--size=",7)==0&&atoi(arg+7)>1) {
+            //服务器一次最多读 BUFFER_SIZE-1 字节，消息不要超过它
+            g_size=std::min(atoi(arg+7),1023);
+        } else {
+            std::cerr<<"未知参数："<<arg<<std::endl;
+            std::cerr<<"用法：churn_bench [--clients=并发数] [--seconds=秒数] [--size=消息字节数]"<<std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<ClientStats> stats(g_clients);
+    double start=now_us();
+    for(int i=0;i<g_clients;++i) {
+        if(pthread_create(&stats[i].tid,nullptr,client_thread,&stats[i])!=0) {
+            std::cerr<<"创建客户端线程失败"<<std::endl;
+            return 1;
+        }
+    }
+    sleep(g_seconds);
+    g_stop=true;
+    std::vector<double> all;
+    long failures=0;
+    for(int i=0;i<g_clients;++i) {
+        pthread_join(stats[i].tid,nullptr);
+        all.insert(all.end(),stats[i].latencies_us.begin(),stats[i].latencies_us.end());
+        failures+=stats[i].failures;
+    }
+    double elapsed=(now_us()-start)/1e6;
+
+    if(all.empty()) {
+        std::cout<<"没有成功的连接（失败 "<<failures<<" 次）"<<std::endl;
+        return 1;
+    }
+    std::sort(all.begin(),all.end());
+    auto percentile=[&](double p) {
+        return all[(size_t)(p*(all.size()-1))];
+    };
+    std::cout<<"并发 "<<g_clients<<"，"<<elapsed<<" 秒，完成连接 "<<all.size()<<"，失败 "<<failures
+             <<"，"<<all.size()/elapsed<<" 连接/秒"<<std::endl;
+    std::cout<<"单连接耗时(us)：p50 "<<percentile(0.5)<<"，p90 "<<percentile(0.9)<<"，p99 "<<percentile(0.99)
+             <<"，max "<<all.back()<<std::endl;
+    return 0;
+}
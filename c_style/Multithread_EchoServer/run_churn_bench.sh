@@ -0,0 +1,29 @@
+#!/bin/bash
+# 依次用三种线程模型启动 server，跑短连接压测
+# per-conn 分别用原来的 backlog=10 和调大后的 backlog 跑，观察队列溢出（SYN 重传）对尾延迟的影响
+# 用法：./run_churn_bench.sh [并发数] [秒数] [线程数]（在 Multithread_EchoServer 目录下执行，server 固定监听 8080）
+set -e
+
+CLIENTS=${1:-64}
+SECONDS_PER_RUN=${2:-5}
+THREADS=${3:-64}
+BUILD_DIR=$(mktemp -d)
+trap 'rm -rf "$BUILD_DIR"' EXIT
+
+g++ -std=c++11 -O2 -pthread -o "$BUILD_DIR/server" server.cpp
+g++ -std=c++11 -O2 -pthread -o "$BUILD_DIR/churn_bench" churn_bench.cpp
+
+run() {
+    "$BUILD_DIR/server" --quiet "$@" > /dev/null &
+    server_pid=$!
+    sleep 0.3
+    echo "===== $* ====="
+    "$BUILD_DIR/churn_bench" --clients="$CLIENTS" --seconds="$SECONDS_PER_RUN"
+    kill "$server_pid"
+    wait "$server_pid" 2> /dev/null || true
+}
+
+run --model=per-conn --backlog=10
+run --model=per-conn --backlog=1024
+run --model=epollex --threads="$THREADS" --backlog=1024
+run --model=leader --threads="$THREADS" --backlog=1024
@@ -3,20 +3,41 @@
 #include<pthread.h>
 #include<unistd.h>
 #include<sys/socket.h>
+#include<sys/epoll.h>
 #include<netinet/in.h>
 #include<string.h>
+#include<stdlib.h>
+#include<errno.h>
 #include<arpa/inet.h>
+#include "usdt.h" //静态探针(USDT),bpftrace/perf 可以直接挂载
 
 #define PORT 8080
 #define BUFFER_SIZE 1024
+#define DEFAULT_THREADS 64   //预创建线程模式下默认的线程数
+#define DEFAULT_BACKLOG 128  //listen 的默认等待队列长度
 
-//
-void *handle_client(void *arg) {
-    int client_fd=*(int*)arg;
-    char buffer[BUFFER_SIZE];
-    struct sockaddr_in client_addr=*(struct sockaddr_in*)((int*)arg+1);
-    free(arg);
+//线程模型
+//  per-conn : 主线程 accept，每个连接新建一个线程（原来的模型）
+//  epollex  : 预先创建固定数量的线程，各自用 EPOLLEXCLUSIVE 监听同一个 listen socket，
+//             新连接只唤醒其中一个线程，由它自己 accept 并服务到连接关闭
+//  leader   : 预先创建固定数量的线程，轮流持锁 accept（leader/follower），accept 到连接后交出锁再服务
+//预创建的两种模型里同时服务的连接数不超过线程数，其余连接在 backlog 里排队
+enum ThreadModel {
+    MODEL_PER_CONN,
+    MODEL_EPOLLEX,
+    MODEL_LEADER,
+};
+
+static ThreadModel g_model=MODEL_PER_CONN;
+static int g_threads=DEFAULT_THREADS;
+static int g_backlog=DEFAULT_BACKLOG;
+static bool g_verbose=true;  //--quiet 关闭逐条消息的打印（压测时打印会成为瓶颈）
+static int g_server_fd=-1;
+static pthread_mutex_t g_accept_lock=PTHREAD_MUTEX_INITIALIZER;  //leader 模型：持有它的线程是 leader
 
+//收发消息直到客户端断开，然后关闭连接
+void serve_client(int client_fd,const struct sockaddr_in &client_addr) {
+    char buffer[BUFFER_SIZE];
     char client_ip[INET_ADDRSTRLEN];
     inet_ntop(AF_INET,&client_addr.sin_addr,client_ip,INET_ADDRSTRLEN);
     uint16_t client_port=ntohs(client_addr.sin_port);
@@ -24,75 +45,173 @@ void *handle_client(void *arg) {
     while(1) {
         memset(buffer,0,BUFFER_SIZE);
         ssize_t read_bytes=read(client_fd,buffer,BUFFER_SIZE-1);
+        if(read_bytes>0) {
+            USDT_PROBE2(read,client_fd,read_bytes);
+        }
         if(read_bytes<=0) {
             if(read_bytes<0) {
                 std::cerr<<"[客户端"<<client_ip<<"："<<client_port<<"] 读取失败"<<std::endl;
-            } else {
+            } else if(g_verbose) {
                 std::cout<<"[客户端"<<client_ip<<"："<<client_port<<"] 断开连接"<<std::endl;
             }
             break;
         }
 
-        std::cout<<"[客户端"<<client_ip<<"："<<client_port<<"] 收到消息："<<buffer;
+        if(g_verbose) {
+            std::cout<<"[客户端"<<client_ip<<"："<<client_port<<"] 收到消息："<<buffer;
+        }
         ssize_t send_bytes=send(client_fd,buffer,read_bytes,0);
+        if(send_bytes>=0) {
+            USDT_PROBE3(write,client_fd,send_bytes,send_bytes<read_bytes);
+        }
         if(send_bytes<0) {
             std::cerr<<"[客户端"<<client_ip<<"："<<client_port<<"] 发送回声消息失败"<<std::endl;
             break;
-        } else {
+        } else if(g_verbose) {
             std::cout<<"[客户端"<<client_ip<<"："<<client_port<<"] 发送回声消息成功"<<std::endl;
         }
     }
+    USDT_PROBE1(close,client_fd);
     close(client_fd);
-    pthread_exit(nullptr);
 }
 
-int main() {
-    //1.创建监听socket
-    int server_fd=socket(AF_INET,SOCK_STREAM,0);
-    if(server_fd<0) {
-        std::cerr<<"创建监听socket失败"<<std::endl;
-        return 0;
+void print_new_client(const struct sockaddr_in &client_addr) {
+    if(!g_verbose) {
+        return;
     }
+    char client_ip[INET_ADDRSTRLEN];
+    inet_ntop(AF_INET,&client_addr.sin_addr,client_ip,INET_ADDRSTRLEN);
+    std::cout<<"\n新客户端连接："<<std::endl;
+    std::cout<<"ip:"<<client_ip<<" port:"<<ntohs(client_addr.sin_port)<<std::endl;
+}
 
-    //2.绑定IP与端口
-    struct sockaddr_in server_addr{};
-    server_addr.sin_family=AF_INET;
-    server_addr.sin_addr.s_addr=INADDR_ANY;
-    server_addr.sin_port=htons(PORT);
+//per-conn 模型：每个连接一个线程
+void *handle_client(void *arg) {
+    int client_fd=*(int*)arg;
+    struct sockaddr_in client_addr=*(struct sockaddr_in*)((int*)arg+1);
+    free(arg);
 
-    if(bind(server_fd,(sockaddr*)&server_addr,sizeof(server_addr))<0) {
-        std::cerr<<"绑定IP与地址失败"<<std::endl;
-        close(server_fd);
-        return 0;
+    serve_client(client_fd,client_addr);
+    pthread_exit(nullptr);
+}
+
+//epollex 模型的工作线程：每个线程有自己的 epoll，listen socket 以 EPOLLEXCLUSIVE 加进去
+//水平触发：一次只 accept 一个连接，backlog 里还有连接时下一个空闲线程的 epoll_wait 会立即返回
+//listen socket 是非阻塞的，被唤醒后连接可能已被别的线程取走，accept 返回 EAGAIN 就继续等
+void *epollex_worker(void *arg) {
+    (void)arg;
+    int epoll_fd=epoll_create1(0);
+    if(epoll_fd<0) {
+        std::cerr<<"创建epoll失败："<<strerror(errno)<<std::endl;
+        return nullptr;
+    }
+    struct epoll_event ev{};
+    ev.events=EPOLLIN|EPOLLEXCLUSIVE;
+    ev.data.fd=g_server_fd;
+    if(epoll_ctl(epoll_fd,EPOLL_CTL_ADD,g_server_fd,&ev)<0) {
+        std::cerr<<"注册EPOLLEXCLUSIVE失败："<<strerror(errno)<<std::endl;
+        close(epoll_fd);
+        return nullptr;
     }
 
-    //3.开始监听
-    if(listen(server_fd,10)<0) {
-        std::cerr<<"监听失败"<<std::endl;
-        close(server_fd);
-        return 0;
+    while(1) {
+        struct epoll_event event;
+        int n=epoll_wait(epoll_fd,&event,1,-1);
+        if(n<0) {
+            if(errno==EINTR) {
+                continue;
+            }
+            std::cerr<<"epoll_wait失败："<<strerror(errno)<<std::endl;
+            break;
+        }
+        struct sockaddr_in client_addr{};
+        socklen_t client_len=sizeof(client_addr);
+        int client_fd=accept4(g_server_fd,(sockaddr*)&client_addr,&client_len,SOCK_CLOEXEC);  //新连接是阻塞的
+        if(client_fd<0) {
+            if(errno!=EAGAIN&&errno!=EWOULDBLOCK) {
+                std::cerr<<"接受连接失败："<<strerror(errno)<<std::endl;
+            }
+            continue;
+        }
+        USDT_PROBE1(accept,client_fd);
+        print_new_client(client_addr);
+        serve_client(client_fd,client_addr);
+    }
+    close(epoll_fd);
+    return nullptr;
+}
+
+//leader 模型的工作线程：拿到锁的线程是 leader，阻塞在 accept 上，其余线程排队等锁（follower）
+//accept 到连接后立刻交出锁，下一个 follower 成为 leader，自己去服务这个连接
+void *leader_worker(void *arg) {
+    (void)arg;
+    while(1) {
+        struct sockaddr_in client_addr{};
+        socklen_t client_len=sizeof(client_addr);
+        pthread_mutex_lock(&g_accept_lock);
+        int client_fd=accept(g_server_fd,(sockaddr*)&client_addr,&client_len);
+        pthread_mutex_unlock(&g_accept_lock);
+        if(client_fd<0) {
+            if(errno!=EINTR) {
+                std::cerr<<"接受连接失败："<<strerror(errno)<<std::endl;
+            }
+            continue;
+        }
+        USDT_PROBE1(accept,client_fd);
+        print_new_client(client_addr);
+        serve_client(client_fd,client_addr);
     }
+    return nullptr;
+}
 
-    std::cout<<"服务端开始监听，端口号为："<<PORT<<std::endl;
+//解析命令行：--model=per-conn|epollex|leader --threads=N --backlog=N --quiet
+bool parse_args(int argc,char *argv[]) {
+    for(int i=1;i<argc;++i) {
+        const char *arg=argv[i];
+        if(strcmp(arg,"--model=per-conn")==0) {
+            g_model=MODEL_PER_CONN;
+        } else if(strcmp(arg,"--model=epollex")==0) {
+            g_model=MODEL_EPOLLEX;
+        } else if(strcmp(arg,"--model=leader")==0) {
+            g_model=MODEL_LEADER;
+        } else if(strncmp(arg,"--threads=",10)==0&&atoi(arg+10)>0) {
+            g_threads=atoi(arg+10);
+        } else if(strncmp(arg,"--backlog=",10)==0&&atoi(arg+10)>0) {
+            g_backlog=atoi(arg+10);
+        } else if(strcmp(arg,"--quiet")==0) {
+            g_verbose=false;
+        } else {
+            std::cerr<<"未知参数："<<arg<<std::endl;
+            std::cerr<<"用法：server [--model=per-conn|epollex|leader] [--threads=线程数] [--backlog=队列长度] [--quiet]"<<std::endl;
+            return false;
+        }
+    }
+    return true;
+}
 
+//per-conn 模型：主线程持续 accept，为每个连接创建子线程
+void run_per_conn() {
     while(1) {
         //主线程持续接收连接
         struct sockaddr_in client_addr{};
         socklen_t client_len=sizeof(client_addr);
-        int client_fd=accept(server_fd,(sockaddr*)&client_addr,&client_len);
+        int client_fd=accept(g_server_fd,(sockaddr*)&client_addr,&client_len);
         if(client_fd<0) {
             std::cerr<<"接受连接失败"<<std::endl;
             continue;
         }
+        USDT_PROBE1(accept,client_fd);
 
         //打印客户端信息
-        char client_ip[INET_ADDRSTRLEN];
-        inet_ntop(AF_INET,&client_addr.sin_addr,client_ip,INET_ADDRSTRLEN);
-        std::cout<<"\n新客户端连接："<<std::endl;
-        std::cout<<"ip:"<<client_ip<<" port:"<<ntohs(client_addr.sin_port)<<std::endl;
+        print_new_client(client_addr);
 
         //创建子线程，用来收发消息
         void* arg=malloc(sizeof(int)+sizeof(struct sockaddr_in));
+        if(arg==nullptr) {
+            std::cerr<<"分配线程参数失败："<<strerror(errno)<<std::endl;
+            close(client_fd);
+            continue;
+        }
         *(int*)arg=client_fd;
         memcpy((int*)arg+1,&client_addr,sizeof(struct sockaddr_in));
 
@@ -101,10 +220,79 @@ int main() {
             std::cerr<<"创建子线程失败"<<std::endl;
             close(client_fd);
             free(arg);
+            continue;
         }
 
         pthread_detach(tid);
     }
+}
+
+//预创建模型：启动工作线程后主线程只等待（工作线程不会退出），一个线程都没启动起来时返回 false
+bool run_prespawned() {
+    void *(*worker)(void*)=g_model==MODEL_EPOLLEX?epollex_worker:leader_worker;
+    pthread_t *tids=(pthread_t*)malloc(sizeof(pthread_t)*g_threads);
+    if(tids==nullptr) {
+        std::cerr<<"分配线程数组失败："<<strerror(errno)<<std::endl;
+        return false;
+    }
+    int started=0;
+    for(int i=0;i<g_threads;++i) {
+        if(pthread_create(&tids[started],nullptr,worker,nullptr)!=0) {
+            std::cerr<<"创建工作线程失败，已创建 "<<started<<" 个"<<std::endl;
+            break;
+        }
+        ++started;
+    }
+    std::cout<<"预创建工作线程："<<started<<" 个（"<<(g_model==MODEL_EPOLLEX?"EPOLLEXCLUSIVE":"leader/follower")
+             <<"）"<<std::endl;
+    for(int i=0;i<started;++i) {
+        pthread_join(tids[i],nullptr);
+    }
+    free(tids);
+    return started>0;
+}
+
+int main(int argc,char *argv[]) {
+    if(!parse_args(argc,argv)) {
+        return 1;
+    }
+
+    //1.创建监听socket（epollex 模型里所有线程共享一个非阻塞的 listen socket）
+    int sock_type=SOCK_STREAM|(g_model==MODEL_EPOLLEX?SOCK_NONBLOCK:0);
+    int server_fd=socket(AF_INET,sock_type,0);
+    if(server_fd<0) {
+        std::cerr<<"创建监听socket失败"<<std::endl;
+        return 0;
+    }
+    g_server_fd=server_fd;
+
+    //2.绑定IP与端口
+    struct sockaddr_in server_addr{};
+    server_addr.sin_family=AF_INET;
+    server_addr.sin_addr.s_addr=INADDR_ANY;
+    server_addr.sin_port=htons(PORT);
+
+    if(bind(server_fd,(sockaddr*)&server_addr,sizeof(server_addr))<0) {
+        std::cerr<<"绑定IP与地址失败"<<std::endl;
+        close(server_fd);
+        return 0;
+    }
+
+    //3.开始监听（backlog 超过 net.core.somaxconn 时内核会截断）
+    if(listen(server_fd,g_backlog)<0) {
+        std::cerr<<"监听失败"<<std::endl;
+        close(server_fd);
+        return 0;
+    }
+
+    std::cout<<"服务端开始监听，端口号为："<<PORT<<"，backlog："<<g_backlog<<std::endl;
+
+    int ret=0;
+    if(g_model==MODEL_PER_CONN) {
+        run_per_conn();
+    } else if(!run_prespawned()) {
+        ret=1;
+    }
     close(server_fd);
-    return 0;
+    return ret;
 }
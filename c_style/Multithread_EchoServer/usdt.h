@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstdint>
+
+// 用户态静态探针（USDT），provider 名为 echo_server，可以用 perf / bpftrace 直接挂载：
+//   bpftrace -e 'usdt:./server:echo_server:read { @bytes = hist(arg1); }'
+// 探针点在二进制里只是一条 nop，参数按 ELF 的 .note.stapsdt 记录在哪个寄存器/栈位置上，
+// 没有挂载时除了把参数准备好之外没有额外开销；编译时定义 USDT_DISABLE 可以彻底去掉
+//
+// 优先用 systemtap 的 <sys/sdt.h>；没有装这个头文件时，x86-64 / aarch64 上自己生成同样格式的 note，
+// 所有参数统一按有符号 64 位记录（格式 "-8@操作数"）
+
+#if defined(USDT_DISABLE)
+
+#define USDT_PROBE0(name) do {} while (0)
+#define USDT_PROBE1(name, a1) do { (void)(a1); } while (0)
+#define USDT_PROBE2(name, a1, a2) do { (void)(a1); (void)(a2); } while (0)
+#define USDT_PROBE3(name, a1, a2, a3) do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+
+#elif __has_include(<sys/sdt.h>)
+
+#include <sys/sdt.h>
+
+#define USDT_PROBE0(name) STAP_PROBE(echo_server, name)
+#define USDT_PROBE1(name, a1) STAP_PROBE1(echo_server, name, a1)
+#define USDT_PROBE2(name, a1, a2) STAP_PROBE2(echo_server, name, a1, a2)
+#define USDT_PROBE3(name, a1, a2, a3) STAP_PROBE3(echo_server, name, a1, a2, a3)
+
+#elif defined(__GNUC__) && defined(__ELF__) && (defined(__x86_64__) || defined(__aarch64__))
+
+// note 的布局和 sys/sdt.h 一致：探针地址、.stapsdt.base 地址（用于修正 prelink 之后的偏移）、
+// 信号量地址（不用，填 0）、provider、探针名、参数描述
+#define USDT_NOTE_(name, args, ...)                                                  \
+    __asm__ __volatile__(                                                            \
+        "990: nop\n"                                                                 \
+        ".pushsection .note.stapsdt,\"?\",\"note\"\n"                                \
+        ".balign 4\n"                                                                \
+        ".4byte 992f-991f, 994f-993f, 3\n"                                           \
+        "991: .asciz \"stapsdt\"\n"                                                  \
+        "992: .balign 4\n"                                                           \
+        "993: .8byte 990b\n"                                                         \
+        ".8byte _.stapsdt.base\n"                                                    \
+        ".8byte 0\n"                                                                 \
+        ".asciz \"echo_server\"\n"                                                   \
+        ".asciz \"" #name "\"\n"                                                     \
+        ".asciz \"" args "\"\n"                                                      \
+        "994: .balign 4\n"                                                           \
+        ".popsection\n"                                                              \
+        ".ifndef _.stapsdt.base\n"                                                   \
+        ".pushsection .stapsdt.base,\"aG\",\"progbits\",.stapsdt.base,comdat\n"      \
+        ".weak _.stapsdt.base\n"                                                     \
+        ".hidden _.stapsdt.base\n"                                                   \
+        "_.stapsdt.base: .space 1\n"                                                 \
+        ".size _.stapsdt.base, 1\n"                                                  \
+        ".popsection\n"                                                              \
+        ".endif\n"                                                                   \
+        :: __VA_ARGS__)
+
+// "nor"：参数可以放在寄存器、常量或可寻址的内存里，由编译器挑最省事的
+#define USDT_ARG_(n, x) [usdt_a##n] "nor"(static_cast<int64_t>(x))
+
+#define USDT_PROBE0(name) USDT_NOTE_(name, "")
+#define USDT_PROBE1(name, a1) USDT_NOTE_(name, "-8@%[usdt_a1]", USDT_ARG_(1, a1))
+#define USDT_PROBE2(name, a1, a2) \
+    USDT_NOTE_(name, "-8@%[usdt_a1] -8@%[usdt_a2]", USDT_ARG_(1, a1), USDT_ARG_(2, a2))
+#define USDT_PROBE3(name, a1, a2, a3)                                         \
+    USDT_NOTE_(name, "-8@%[usdt_a1] -8@%[usdt_a2] -8@%[usdt_a3]",             \
+               USDT_ARG_(1, a1), USDT_ARG_(2, a2), USDT_ARG_(3, a3))
+
+#else
+
+// 其他平台不生成探针
+#define USDT_PROBE0(name) do {} while (0)
+#define USDT_PROBE1(name, a1) do { (void)(a1); } while (0)
+#define USDT_PROBE2(name, a1, a2) do { (void)(a1); (void)(a2); } while (0)
+#define USDT_PROBE3(name, a1, a2, a3) do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+
+#endif
+
+// 探针参数里区分读写方向的取值（eagain 探针的第二个参数）
+enum UsdtDirection : int {
+    USDT_DIR_READ = 0,
+    USDT_DIR_WRITE = 1,
+};
@@ -8,6 +8,7 @@
 #include<unistd.h>
 #include<arpa/inet.h>
 #include<system_error>
+#include "usdt.h" //静态探针(USDT),bpftrace/perf 可以直接挂载
 
 #define PORT 8080
 #define BUFFER_SIZE 1024
@@ -51,6 +52,9 @@ private:
         while(1) {
             char raw_buf[BUFFER_SIZE];
             ssize_t read_bytes=read(client_fd,raw_buf,BUFFER_SIZE);
+            if(read_bytes > 0) {
+                USDT_PROBE2(read,client_fd,read_bytes);
+            }
             if(read_bytes <= 0) {
                 {
                     std::lock_guard<std::mutex>lock(cout_mutex);
@@ -71,6 +75,9 @@ private:
             }
 
             ssize_t sent_bytes=send(client_fd,buffer.c_str(),buffer.length(),0);
+            if(sent_bytes >= 0) {
+                USDT_PROBE3(write,client_fd,sent_bytes,static_cast<size_t>(sent_bytes) < buffer.length());
+            }
             if(sent_bytes < 0) {
                 std::lock_guard<std::mutex>lock(cout_mutex);
                 std::cerr << "发送回声消息到客户端[" << client_ip << ":" << client_port << "]失败: " << std::strerror(errno) << "\n";
@@ -78,6 +85,7 @@ private:
                 break;
             }
         }
+        USDT_PROBE1(close,client_fd);
         close(client_fd);
         print_client_info(client_data.get(),"客户端连接关闭");
     }  
@@ -124,6 +132,7 @@ public:
                 std::cerr << "接受客户端连接失败: " << std::strerror(errno) << "\n";
                 continue;
             }
+            USDT_PROBE1(accept,client_fd);
 
             //封装客户端数据
             auto client_data=std::make_unique<ClientData>();
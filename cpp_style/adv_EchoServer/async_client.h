@@ -0,0 +1,510 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "lockfree_queue.h"
+
+// 怎样从字节流里切出一个请求的回复
+//   Echo：回复和请求一样长（回声模式，对任何回声服务器都成立，请求里不要求有换行）
+//   Line：回复是一行，以 '\n' 结尾（offload 模式这类会改写内容的服务器）
+enum class ReplyFraming { Echo, Line };
+
+struct AsyncClientOptions {
+    size_t connections = 4;                 // 每个地址最多建立的连接数
+    size_t max_inflight = 128;              // 每个连接上最多同时在途的请求数（管道深度），超出的在地址上排队
+    ReplyFraming framing = ReplyFraming::Echo;
+    size_t max_line = 1024 * 1024;          // Line 模式下一行回复的上限，超过按协议错误断开
+};
+
+// 回调在客户端的事件循环线程上执行，不要在里面阻塞；出错时 reply 为空
+using ReplyCallback = std::function<void(std::error_code error, std::string reply)>;
+
+// 异步管道化客户端：自带一个 epoll 事件循环线程，按地址维护连接池
+// 地址写成 "IP:端口" 或 "unix:路径"，第一次使用时才建立连接
+// 同一连接上的请求按提交顺序连续发出、不等回复（管道化），回复按顺序和请求对应；
+// 一轮事件循环里攒下的请求拼在一起用一次 send 发出（批量写）
+// call 可以在任意线程（包括回调里）调用：请求经无锁 MPSC 队列交给事件循环，只在循环空闲时写 eventfd 叫醒它
+class AsyncClient {
+private:
+    struct Call {
+        std::string endpoint;
+        std::string request;      // 进入连接的发送缓冲后清空，只留 request_size
+        size_t request_size = 0;
+        ReplyCallback callback;
+        Call* next = nullptr;     // MpscQueue 的链表指针
+    };
+
+    struct Endpoint;
+
+    struct Connection {
+        int fd = -1;
+        Endpoint* endpoint = nullptr;
+        bool connecting = false;             // 非阻塞 connect 还没完成
+        bool dirty = false;                  // 本轮有新数据要发，已放进 dirty 列表
+        bool closed = false;
+        std::string out;                     // 待发送的请求，拼接在一起
+        size_t out_offset = 0;               // out 中已经发出的字节数
+        std::string in;                      // 收到但还没凑成完整回复的数据
+        std::deque<std::unique_ptr<Call>> inflight;  // 已进入 out 等待回复的请求，按发送顺序
+    };
+
+    struct Endpoint {
+        std::string name;
+        struct sockaddr_storage addr{};
+        socklen_t addr_len = 0;
+        std::vector<Connection*> connections;
+        std::deque<std::unique_ptr<Call>> backlog;   // 所有连接的管道都满时在这里排队
+    };
+
+    AsyncClientOptions options;
+    int epoll_fd = -1;
+    int wake_fd = -1;                        // 提交请求时叫醒事件循环
+    std::atomic<bool> wake_pending{false};   // 已经写过 wake_fd、循环还没处理，其他提交者不必再写
+    std::atomic<bool> stopping{false};
+    MpscQueue<Call> submissions;
+    std::thread loop_thread;
+
+    // 以下只在事件循环线程访问
+    std::unordered_map<std::string, std::unique_ptr<Endpoint>> endpoints;
+    std::vector<Connection*> dirty;
+    std::vector<Connection*> closed;         // 本轮关闭的连接，循环末尾统一释放（dirty 里可能还指着它们）
+
+    std::atomic<uint64_t> requests_sent{0};
+    std::atomic<uint64_t> send_calls{0};
+    std::atomic<uint64_t> connects{0};
+
+    static void fail(Call* call, int err) {
+        call->callback(std::error_code(err, std::generic_category()), std::string());
+    }
+
+    // 解析 "IP:端口" 或 "unix:路径"
+    static bool parse_endpoint(std::string_view text, Endpoint& endpoint) {
+        if (text.starts_with("unix:")) {
+            std::string_view path = text.substr(5);
+            struct sockaddr_un* addr = reinterpret_cast<struct sockaddr_un*>(&endpoint.addr);
+            if (path.empty() || path.size() >= sizeof(addr->sun_path)) {
+                return false;
+            }
+            addr->sun_family = AF_UNIX;
+            memcpy(addr->sun_path, path.data(), path.size());
+            endpoint.addr_len = sizeof(struct sockaddr_un);
+            return true;
+        }
+        size_t colon = text.rfind(':');
+        if (colon == std::string_view::npos) {
+            return false;
+        }
+        struct sockaddr_in* addr = reinterpret_cast<struct sockaddr_in*>(&endpoint.addr);
+        addr->sin_family = AF_INET;
+        int port = atoi(std::string(text.substr(colon + 1)).c_str());
+        if (port <= 0 || port > 65535 || inet_pton(AF_INET, std::string(text.substr(0, colon)).c_str(), &addr->sin_addr) != 1) {
+            return false;
+        }
+        addr->sin_port = htons(static_cast<uint16_t>(port));
+        endpoint.addr_len = sizeof(struct sockaddr_in);
+        return true;
+    }
+
+    // 建立一个非阻塞连接并注册到 epoll（边缘触发，读写事件都一直关注，之后不再 epoll_ctl），失败返回 errno
+    int open_connection(Endpoint* endpoint, Connection*& conn) {
+        int fd = socket(endpoint->addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd == -1) {
+            return errno;
+        }
+        if (endpoint->addr.ss_family == AF_INET) {
+            int opt = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+        }
+        bool connecting = false;
+        if (connect(fd, reinterpret_cast<struct sockaddr*>(&endpoint->addr), endpoint->addr_len) == -1) {
+            if (errno != EINPROGRESS) {
+                int err = errno;
+                close(fd);
+                return err;
+            }
+            connecting = true;
+        }
+        conn = new Connection();
+        conn->fd = fd;
+        conn->endpoint = endpoint;
+        conn->connecting = connecting;
+        struct epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+        ev.data.ptr = conn;
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            int err = errno;
+            close(fd);
+            delete conn;
+            conn = nullptr;
+            return err;
+        }
+        endpoint->connections.push_back(conn);
+        connects.fetch_add(1, std::memory_order_relaxed);
+        return 0;
+    }
+
+    void enqueue(Connection* conn, std::unique_ptr<Call> call) {
+        conn->out.append(call->request);
+        call->request_size = call->request.size();
+        std::string().swap(call->request);
+        conn->inflight.push_back(std::move(call));
+        requests_sent.fetch_add(1, std::memory_order_relaxed);
+        if (!conn->dirty) {
+            conn->dirty = true;
+            dirty.push_back(conn);
+        }
+    }
+
+    // 选在途请求最少的连接；最空闲的连接也有请求在途且连接数没到上限时，新建一条分担
+    void dispatch(std::unique_ptr<Call> call) {
+        auto it = endpoints.find(call->endpoint);
+        if (it == endpoints.end()) {
+            auto endpoint = std::make_unique<Endpoint>();
+            endpoint->name = call->endpoint;
+            if (!parse_endpoint(endpoint->name, *endpoint)) {
+                fail(call.get(), EINVAL);
+                return;
+            }
+            it = endpoints.emplace(endpoint->name, std::move(endpoint)).first;
+        }
+        Endpoint* endpoint = it->second.get();
+        if (!endpoint->backlog.empty()) {
+            endpoint->backlog.push_back(std::move(call));  // 保持提交顺序
+            return;
+        }
+
+        Connection* best = nullptr;
+        for (Connection* conn : endpoint->connections) {
+            if (best == nullptr || conn->inflight.size() < best->inflight.size()) {
+                best = conn;
+            }
+        }
+        if ((best == nullptr || !best->inflight.empty()) && endpoint->connections.size() < options.connections) {
+            Connection* conn = nullptr;
+            int err = open_connection(endpoint, conn);
+            if (err == 0) {
+                best = conn;
+            } else if (best == nullptr) {
+                fail(call.get(), err);
+                return;
+            }
+        }
+        if (best->inflight.size() >= options.max_inflight) {
+            endpoint->backlog.push_back(std::move(call));
+            return;
+        }
+        enqueue(best, std::move(call));
+    }
+
+    // 连接上有空位后，从地址的排队队列里补请求
+    void refill(Connection* conn) {
+        Endpoint* endpoint = conn->endpoint;
+        while (!endpoint->backlog.empty() && conn->inflight.size() < options.max_inflight) {
+            enqueue(conn, std::move(endpoint->backlog.front()));
+            endpoint->backlog.pop_front();
+        }
+    }
+
+    // 连接出错或被对端关闭：在途请求全部以 err 失败；地址上没有连接了就把排队的请求重新分派（会新建连接）
+    void close_connection(Connection* conn, int err) {
+        if (conn->closed) {
+            return;
+        }
+        conn->closed = true;
+        close(conn->fd);
+        Endpoint* endpoint = conn->endpoint;
+        std::erase(endpoint->connections, conn);
+        closed.push_back(conn);
+        auto inflight = std::move(conn->inflight);
+        for (auto& call : inflight) {
+            fail(call.get(), err);
+        }
+        if (endpoint->connections.empty() && !endpoint->backlog.empty()) {
+            auto backlog = std::move(endpoint->backlog);
+            for (auto& call : backlog) {
+                dispatch(std::move(call));
+            }
+        }
+    }
+
+    // 把 out 里攒下的请求尽量发出去；发不完留到下次可写事件（边缘触发会再通知）
+    void flush(Connection* conn) {
+        while (conn->out_offset < conn->out.size()) {
+            ssize_t n = send(conn->fd, conn->out.data() + conn->out_offset, conn->out.size() - conn->out_offset,
+                             MSG_NOSIGNAL);
+            if (n == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    close_connection(conn, errno);
+                }
+                return;
+            }
+            send_calls.fetch_add(1, std::memory_order_relaxed);
+            conn->out_offset += n;
+        }
+        conn->out.clear();
+        conn->out_offset = 0;
+    }
+
+    // 按顺序把完整的回复交给对应请求的回调，出现协议错误时关闭连接
+    void deliver_replies(Connection* conn) {
+        size_t offset = 0;
+        while (!conn->inflight.empty() && !conn->closed) {
+            Call* call = conn->inflight.front().get();
+            size_t len;
+            if (options.framing == ReplyFraming::Echo) {
+                len = call->request_size;
+                if (conn->in.size() - offset < len) {
+                    break;
+                }
+            } else {
+                size_t newline = conn->in.find('\n', offset);
+                if (newline == std::string::npos) {
+                    if (conn->in.size() - offset > options.max_line) {
+                        close_connection(conn, EMSGSIZE);
+                        return;
+                    }
+                    break;
+                }
+                len = newline + 1 - offset;
+            }
+            std::unique_ptr<Call> done = std::move(conn->inflight.front());
+            conn->inflight.pop_front();
+            done->callback(std::error_code(), conn->in.substr(offset, len));
+            offset += len;
+        }
+        if (conn->closed) {
+            return;
+        }
+        conn->in.erase(0, offset);
+        if (conn->inflight.empty() && !conn->in.empty()) {
+            close_connection(conn, EPROTO);  // 没有请求在等，却收到了数据
+        }
+    }
+
+    void handle_connection_event(Connection* conn, uint32_t events) {
+        if (conn->connecting && (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))) {
+            int err = 0;
+            socklen_t err_len = sizeof(err);
+            if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &err_len) == -1) {
+                err = errno;
+            }
+            if (err != 0) {
+                close_connection(conn, err);
+                return;
+            }
+            conn->connecting = false;
+        }
+        if (events & EPOLLIN) {
+            char buf[64 * 1024];
+            while (true) {
+                ssize_t n = read(conn->fd, buf, sizeof(buf));
+                if (n > 0) {
+                    conn->in.append(buf, n);
+                    continue;
+                }
+                if (n == -1 && errno == EINTR) {
+                    continue;
+                }
+                if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    break;
+                }
+                deliver_replies(conn);  // 对端关闭前发来的回复照常交付
+                close_connection(conn, n == 0 ? ECONNRESET : errno);
+                return;
+            }
+            deliver_replies(conn);
+            if (conn->closed) {
+                return;
+            }
+            refill(conn);
+        } else if (events & (EPOLLERR | EPOLLHUP)) {
+            close_connection(conn, ECONNRESET);
+            return;
+        }
+        if (!conn->closed && !conn->connecting && (events & EPOLLOUT) && conn->out_offset < conn->out.size() &&
+            !conn->dirty) {
+            conn->dirty = true;
+            dirty.push_back(conn);
+        }
+    }
+
+    void drain_submissions() {
+        wake_pending.store(false);
+        uint64_t count;
+        ssize_t ret = read(wake_fd, &count, sizeof(count));
+        (void)ret;
+        Call* call = submissions.pop_all();
+        while (call != nullptr) {
+            Call* next = call->next;
+            dispatch(std::unique_ptr<Call>(call));
+            call = next;
+        }
+    }
+
+    // 一轮事件处理完后，每个有新数据的连接各发一次（连接中的等 connect 完成后再发）
+    void flush_dirty() {
+        for (size_t i = 0; i < dirty.size(); ++i) {
+            Connection* conn = dirty[i];
+            conn->dirty = false;
+            if (!conn->closed && !conn->connecting) {
+                flush(conn);
+            }
+        }
+        dirty.clear();
+        for (Connection* conn : closed) {
+            delete conn;
+        }
+        closed.clear();
+    }
+
+    // 退出前让所有还没完成的请求以 ECANCELED 失败
+    // 失败回调里还可能再调用 call()（比如完成一个补一个的用法），所以最后要反复清空提交队列直到它为空；
+    // 这些新请求同样以 ECANCELED 失败，回调不要在收到 ECANCELED 后无条件重试，否则这里停不下来
+    void cancel_all() {
+        for (auto& [name, endpoint] : endpoints) {
+            for (auto& pending : endpoint->backlog) {
+                fail(pending.get(), ECANCELED);
+            }
+            endpoint->backlog.clear();
+            while (!endpoint->connections.empty()) {
+                close_connection(endpoint->connections.back(), ECANCELED);
+            }
+        }
+        flush_dirty();
+        while (Call* call = submissions.pop_all()) {
+            while (call != nullptr) {
+                Call* next = call->next;
+                fail(call, ECANCELED);
+                delete call;
+                call = next;
+            }
+        }
+    }
+
+    void run_loop() {
+        struct epoll_event events[64];
+        while (!stopping.load(std::memory_order_relaxed)) {
+            int n = epoll_wait(epoll_fd, events, 64, -1);
+            if (n == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            bool woken = false;
+            for (int i = 0; i < n; ++i) {
+                if (events[i].data.ptr == nullptr) {
+                    woken = true;
+                    continue;
+                }
+                Connection* conn = static_cast<Connection*>(events[i].data.ptr);
+                if (!conn->closed) {
+                    handle_connection_event(conn, events[i].events);
+                }
+            }
+            if (woken) {
+                drain_submissions();
+            }
+            flush_dirty();
+        }
+        cancel_all();
+    }
+
+public:
+    explicit AsyncClient(const AsyncClientOptions& opts = AsyncClientOptions()) : options(opts) {
+        if (options.connections == 0 || options.max_inflight == 0) {
+            throw std::invalid_argument("连接数和管道深度至少为 1");
+        }
+        epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "创建 epoll 失败");
+        }
+        wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (wake_fd == -1) {
+            int err = errno;
+            close(epoll_fd);
+            throw std::system_error(err, std::generic_category(), "创建 eventfd 失败");
+        }
+        struct epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.ptr = nullptr;  // data.ptr 为空的事件就是 wake_fd
+        if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &ev) == -1) {
+            int err = errno;
+            close(wake_fd);
+            close(epoll_fd);
+            throw std::system_error(err, std::generic_category(), "注册 eventfd 失败");
+        }
+        loop_thread = std::thread([this] { run_loop(); });
+    }
+
+    // 析构会让所有没完成的请求以 ECANCELED 失败；析构开始后只允许在回调里调用 call()，其他线程不能再调用
+    ~AsyncClient() {
+        stopping.store(true);
+        uint64_t one = 1;
+        ssize_t ret = write(wake_fd, &one, sizeof(one));
+        (void)ret;
+        loop_thread.join();
+        close(wake_fd);
+        close(epoll_fd);
+    }
+
+    AsyncClient(const AsyncClient&) = delete;
+    AsyncClient& operator=(const AsyncClient&) = delete;
+
+    // 异步发送一个请求，回复（或错误）交给 callback；地址无效时回调收到 EINVAL
+    // 不能和析构并发调用（回调里除外，见 ~AsyncClient）
+    void call(const std::string& endpoint, std::string request, ReplyCallback callback) {
+        Call* call = new Call();
+        call->endpoint = endpoint;
+        call->request = std::move(request);
+        call->callback = std::move(callback);
+        submissions.push(call);
+        if (!wake_pending.exchange(true)) {
+            uint64_t one = 1;
+            ssize_t ret = write(wake_fd, &one, sizeof(one));
+            (void)ret;
+        }
+    }
+
+    // future 版本：出错时 get() 抛出 std::system_error
+    std::future<std::string> call(const std::string& endpoint, std::string request) {
+        auto promise = std::make_shared<std::promise<std::string>>();
+        std::future<std::string> future = promise->get_future();
+        call(endpoint, std::move(request), [promise](std::error_code error, std::string reply) {
+            if (error) {
+                promise->set_exception(std::make_exception_ptr(std::system_error(error, "请求失败")));
+            } else {
+                promise->set_value(std::move(reply));
+            }
+        });
+        return future;
+    }
+
+    uint64_t get_requests_sent() const { return requests_sent.load(std::memory_order_relaxed); }
+    uint64_t get_send_calls() const { return send_calls.load(std::memory_order_relaxed); }
+    uint64_t get_connects() const { return connects.load(std::memory_order_relaxed); }
+};
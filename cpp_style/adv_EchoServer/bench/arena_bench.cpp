@@ -0,0 +1,193 @@
+// 缓冲块 arena 压测：模拟大量连接各持有一个读缓冲块，随机挑连接做"读入 → 写出"的拷贝
+// 比较块从堆上分配（和连接状态交错分布在 4K 页上）与从 arena（普通页 / 透明大页 / hugetlb）切分时的
+// 吞吐和 dTLB miss 次数（perf_event_open 读硬件计数器，虚拟机或没有权限时显示不可用）
+// 用法：arena_bench [--pages=heap|auto|hugetlb|thp|none] [--connections=50000] [--ops=10000000] [--size=512]
+//       一个进程只能初始化一次 arena，各种页类型的对比见 run_arena_bench.sh
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+
+#include "../buffer_pool.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t READ_BLOCK_SIZE = 4096;  // 每个连接的读缓冲块（服务器默认的读分级）
+
+struct BenchConfig {
+    std::string pages = "auto";
+    size_t connections = 50000;
+    size_t ops = 10000000;
+    size_t size = 512;  // 每次读写的字节数
+};
+
+// 连接状态：和服务器里的 ClientData 一样在堆上单独分配
+struct Conn {
+    IoBlock* block;
+    uint64_t bytes = 0;
+    char state[240];
+};
+
+BenchConfig parse_args(int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        std::string value(arg.substr(arg.find('=') + 1));
+        if (arg.starts_with("--pages=")) {
+            config.pages = value;
+        } else if (arg.starts_with("--connections=")) {
+            config.connections = std::max<size_t>(1, std::stoul(value));
+        } else if (arg.starts_with("--ops=")) {
+            config.ops = std::stoul(value);
+        } else if (arg.starts_with("--size=")) {
+            config.size = std::clamp<size_t>(std::stoul(value), 1, READ_BLOCK_SIZE);
+        } else {
+            throw std::invalid_argument("未知参数：" + std::string(arg));
+        }
+    }
+    return config;
+}
+
+// 打开一个只统计用户态的硬件 cache 计数器，不可用时返回 -1
+int open_dtlb_counter(uint64_t op) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (op << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+}
+
+uint64_t read_counter(int fd) {
+    uint64_t value = 0;
+    if (fd == -1 || read(fd, &value, sizeof(value)) != sizeof(value)) {
+        return 0;
+    }
+    return value;
+}
+
+// 当前进程实际用上的透明大页（/proc/self/smaps_rollup 的 AnonHugePages）
+std::string anon_huge_pages() {
+    std::ifstream in("/proc/self/smaps_rollup");
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.starts_with("AnonHugePages:")) {
+            return line.substr(line.find_first_not_of(' ', 14));
+        }
+    }
+    return "未知";
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchConfig config = parse_args(argc, argv);
+
+        const char* pages_name = "heap";
+        if (config.pages != "heap") {
+            ArenaPages wanted = ArenaPages::Auto;
+            if (config.pages == "hugetlb") {
+                wanted = ArenaPages::HugeTlb;
+            } else if (config.pages == "thp") {
+                wanted = ArenaPages::Transparent;
+            } else if (config.pages == "none") {
+                wanted = ArenaPages::Regular;
+            } else if (config.pages != "auto") {
+                throw std::invalid_argument("未知页类型：" + config.pages);
+            }
+            // 每个 slab 切成 16 个 4K 块
+            size_t slabs = (config.connections + SLAB_SIZE / READ_BLOCK_SIZE - 1) / (SLAB_SIZE / READ_BLOCK_SIZE);
+            switch (g_block_arena.init(slabs * SLAB_SIZE, wanted, false)) {
+                case ArenaPages::HugeTlb: pages_name = "hugetlb"; break;
+                case ArenaPages::Transparent: pages_name = "thp"; break;
+                default: pages_name = "none"; break;
+            }
+        }
+
+        // 连接状态和读缓冲块交替分配，堆上的块会和连接状态穿插在一起
+        BufferPool pool;
+        std::vector<std::unique_ptr<Conn>> conns;
+        conns.reserve(config.connections);
+        for (size_t i = 0; i < config.connections; ++i) {
+            conns.push_back(std::make_unique<Conn>());
+            conns.back()->block = pool.acquire(READ_BLOCK_SIZE);
+        }
+
+        std::vector<char> source(READ_BLOCK_SIZE, 'x');
+        std::vector<char> sink(READ_BLOCK_SIZE);
+
+        int load_fd = open_dtlb_counter(PERF_COUNT_HW_CACHE_OP_READ);
+        int store_fd = open_dtlb_counter(PERF_COUNT_HW_CACHE_OP_WRITE);
+        for (int fd : {load_fd, store_fd}) {
+            if (fd != -1) {
+                ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+                ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+            }
+        }
+
+        // xorshift 随机挑连接，模拟就绪事件落在任意连接上
+        uint64_t rng = 0x9E3779B97F4A7C15ull;
+        uint64_t checksum = 0;
+        auto t0 = Clock::now();
+        for (size_t op = 0; op < config.ops; ++op) {
+            rng ^= rng << 13;
+            rng ^= rng >> 7;
+            rng ^= rng << 17;
+            Conn* conn = conns[rng % conns.size()].get();
+            IoBlock* block = conn->block;
+            memcpy(block->data, source.data(), config.size);  // read() 把数据拷进读缓冲
+            block->size = static_cast<uint32_t>(config.size);
+            memcpy(sink.data(), block->data, block->size);      // send() 把数据从缓冲拷走
+            conn->bytes += block->size;
+            checksum += static_cast<unsigned char>(sink[op % config.size]);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+        for (int fd : {load_fd, store_fd}) {
+            if (fd != -1) {
+                ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            }
+        }
+        uint64_t load_misses = read_counter(load_fd);
+        uint64_t store_misses = read_counter(store_fd);
+
+        std::cout << "页类型 " << pages_name << "（要求 " << config.pages << "），连接 " << config.connections
+                  << "，操作 " << config.ops << " 次 x " << config.size << " 字节，AnonHugePages " << anon_huge_pages()
+                  << "\n"
+                  << "耗时 " << seconds * 1e9 / config.ops << " ns/次，吞吐 "
+                  << config.ops * config.size * 2 / seconds / 1e9 << " GB/s（读写各一次拷贝）\n";
+        if (load_fd == -1 && store_fd == -1) {
+            std::cout << "dTLB miss：不可用（perf_event_open：" << std::strerror(errno) << "）\n";
+        } else {
+            std::cout << "dTLB miss：load " << static_cast<double>(load_misses) / config.ops
+                      << " 次/操作，store " << static_cast<double>(store_misses) / config.ops << " 次/操作\n";
+        }
+        std::cout << "（校验和 " << checksum << "）" << std::endl;
+
+        for (auto& conn : conns) {
+            pool.release(conn->block);
+        }
+        for (int fd : {load_fd, store_fd}) {
+            if (fd != -1) {
+                close(fd);
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "压测失败：" << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,254 @@
+// 客户端吞吐对比：阻塞客户端（每个线程一条连接，发一个收一个，和 c_style/*/client.cpp 一样）
+// 与 AsyncClient（连接池 + 管道化 + 批量写，分别用回调和 future 提交）
+// 对端可以是任何一个回声服务器，例如：
+//   ./server --quiet --port=18080                      → --endpoint=127.0.0.1:18080
+//   ./server --quiet --unix=/tmp/echo.sock             → --endpoint=unix:/tmp/echo.sock
+//   c_style/Multithread_EchoServer/server --quiet      → --endpoint=127.0.0.1:8080（消息不要超过 1023 字节）
+// 用法：client_throughput [--endpoint=127.0.0.1:8080] [--modes=blocking,callback,future] [--requests=200000]
+//                         [--size=32] [--connections=4] [--depth=64]
+//       blocking 用 --connections 个线程；callback 保持 connections*depth 个请求在途；
+//       future 每轮提交 connections*depth 个请求再逐个 get()。完整流程见 run_client_throughput.sh
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../async_client.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchConfig {
+    std::string endpoint = "127.0.0.1:8080";
+    std::vector<std::string> modes = {"blocking", "callback", "future"};
+    size_t requests = 200000;
+    size_t size = 32;
+    size_t connections = 4;
+    size_t depth = 64;
+};
+
+BenchConfig parse_args(int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        std::string value(arg.substr(arg.find('=') + 1));
+        if (arg.starts_with("--endpoint=")) {
+            config.endpoint = value;
+        } else if (arg.starts_with("--modes=")) {
+            config.modes.clear();
+            std::stringstream in(value);
+            std::string name;
+            while (std::getline(in, name, ',')) {
+                if (name != "blocking" && name != "callback" && name != "future") {
+                    throw std::invalid_argument("未知模式：" + name);
+                }
+                config.modes.push_back(name);
+            }
+        } else if (arg.starts_with("--requests=")) {
+            config.requests = std::max<size_t>(1, std::stoul(value));
+        } else if (arg.starts_with("--size=")) {
+            config.size = std::max<size_t>(2, std::stoul(value));
+        } else if (arg.starts_with("--connections=")) {
+            config.connections = std::max<size_t>(1, std::stoul(value));
+        } else if (arg.starts_with("--depth=")) {
+            config.depth = std::max<size_t>(1, std::stoul(value));
+        } else {
+            throw std::invalid_argument("未知参数：" + std::string(arg));
+        }
+    }
+    return config;
+}
+
+// 阻塞客户端的连接，地址格式和 AsyncClient 一样
+int connect_blocking(const std::string& endpoint) {
+    struct sockaddr_storage storage{};
+    socklen_t len;
+    if (endpoint.starts_with("unix:")) {
+        struct sockaddr_un* addr = reinterpret_cast<struct sockaddr_un*>(&storage);
+        addr->sun_family = AF_UNIX;
+        strncpy(addr->sun_path, endpoint.c_str() + 5, sizeof(addr->sun_path) - 1);
+        len = sizeof(struct sockaddr_un);
+    } else {
+        size_t colon = endpoint.rfind(':');
+        struct sockaddr_in* addr = reinterpret_cast<struct sockaddr_in*>(&storage);
+        addr->sin_family = AF_INET;
+        if (colon == std::string::npos ||
+            inet_pton(AF_INET, endpoint.substr(0, colon).c_str(), &addr->sin_addr) != 1) {
+            throw std::invalid_argument("地址格式应为 IP:端口 或 unix:路径：" + endpoint);
+        }
+        addr->sin_port = htons(static_cast<uint16_t>(std::stoi(endpoint.substr(colon + 1))));
+        len = sizeof(struct sockaddr_in);
+    }
+    int fd = socket(storage.ss_family, SOCK_STREAM, 0);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "创建 socket 失败");
+    }
+    if (connect(fd, reinterpret_cast<struct sockaddr*>(&storage), len) == -1) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "连接失败：" + endpoint);
+    }
+    if (storage.ss_family == AF_INET) {
+        int opt = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    }
+    return fd;
+}
+
+void run_blocking(const BenchConfig& config, const std::string& request) {
+    std::atomic<size_t> errors{0};
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < config.connections; ++t) {
+        size_t count = config.requests / config.connections + (t < config.requests % config.connections ? 1 : 0);
+        threads.emplace_back([&, count] {
+            int fd = connect_blocking(config.endpoint);
+            std::string reply(request.size(), '\0');
+            for (size_t i = 0; i < count; ++i) {
+                if (send(fd, request.data(), request.size(), MSG_NOSIGNAL) != static_cast<ssize_t>(request.size())) {
+                    ++errors;
+                    break;
+                }
+                size_t received = 0;
+                while (received < reply.size()) {
+                    ssize_t n = read(fd, reply.data() + received, reply.size() - received);
+                    if (n <= 0) {
+                        break;
+                    }
+                    received += n;
+                }
+                if (reply != request) {
+                    ++errors;
+                    break;
+                }
+            }
+            close(fd);
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    if (errors != 0) {
+        throw std::runtime_error("阻塞客户端收发失败或回声内容不一致");
+    }
+}
+
+// 回调模式：先放出 connections*depth 个请求，每完成一个就在回调里补一个
+void run_callback(AsyncClient& client, const BenchConfig& config, const std::string& request) {
+    std::mutex mutex;
+    std::condition_variable done_cv;
+    size_t completed = 0;
+    std::atomic<size_t> issued{0};
+    std::error_code first_error;
+
+    std::function<void()> issue = [&] {
+        if (issued.fetch_add(1) >= config.requests) {
+            return;
+        }
+        client.call(config.endpoint, request, [&](std::error_code error, std::string reply) {
+            issue();  // 先补下一个：计数到齐后主线程会返回，之后不能再碰这里的局部变量
+            if (!error && reply != request) {
+                error = std::make_error_code(std::errc::protocol_error);
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error && !first_error) {
+                    first_error = error;
+                }
+                if (++completed == config.requests) {
+                    done_cv.notify_one();
+                }
+            }
+        });
+    };
+    size_t window = std::min(config.requests, config.connections * config.depth);
+    for (size_t i = 0; i < window; ++i) {
+        issue();
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    done_cv.wait(lock, [&] { return completed == config.requests; });
+    if (first_error) {
+        throw std::system_error(first_error, "回调模式请求失败");
+    }
+}
+
+// future 模式：每轮提交一批，再按顺序 get()
+void run_future(AsyncClient& client, const BenchConfig& config, const std::string& request) {
+    size_t batch = config.connections * config.depth;
+    std::vector<std::future<std::string>> futures;
+    futures.reserve(batch);
+    for (size_t done = 0; done < config.requests;) {
+        size_t count = std::min(batch, config.requests - done);
+        for (size_t i = 0; i < count; ++i) {
+            futures.push_back(client.call(config.endpoint, request));
+        }
+        for (auto& future : futures) {
+            if (future.get() != request) {
+                throw std::runtime_error("future 模式回声内容不一致");
+            }
+        }
+        futures.clear();
+        done += count;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchConfig config = parse_args(argc, argv);
+        std::string request(config.size - 1, 'x');
+        request += '\n';
+
+        std::cout << config.endpoint << "：" << config.requests << " 次请求 x " << config.size << " 字节，"
+                  << config.connections << " 条连接" << std::endl;
+        for (const std::string& mode : config.modes) {
+            std::unique_ptr<AsyncClient> client;
+            if (mode != "blocking") {
+                AsyncClientOptions options;
+                options.connections = config.connections;
+                options.max_inflight = config.depth;
+                client = std::make_unique<AsyncClient>(options);
+                client->call(config.endpoint, request).get();  // 预热：先建好第一条连接
+            }
+            uint64_t sent_before = client ? client->get_requests_sent() : 0;
+            uint64_t sends_before = client ? client->get_send_calls() : 0;
+
+            auto t0 = Clock::now();
+            if (mode == "blocking") {
+                run_blocking(config, request);
+            } else if (mode == "callback") {
+                run_callback(*client, config, request);
+            } else {
+                run_future(*client, config, request);
+            }
+            double seconds = std::chrono::duration<double>(Clock::now() - t0).count();
+
+            std::cout << mode << "：" << seconds << " 秒，" << config.requests / seconds << " 次/秒";
+            if (client) {
+                uint64_t sent = client->get_requests_sent() - sent_before;
+                uint64_t sends = client->get_send_calls() - sends_before;
+                std::cout << "（管道深度 " << config.depth << "，平均每次 send 合并 "
+                          << static_cast<double>(sent) / std::max<uint64_t>(1, sends) << " 个请求，建立连接 "
+                          << client->get_connects() << " 条）";
+            }
+            std::cout << std::endl;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "压测失败：" << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
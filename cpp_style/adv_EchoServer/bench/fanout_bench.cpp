@@ -0,0 +1,199 @@
+// 房间模式广播压测：N 个订阅者 + 1 个发布者
+// 发布者每轮发一条带轮次号的消息，记录从发送到最后一个订阅者收到为止的耗时（整轮广播完成时间）
+// 用法：先启动 server --mode=room --quiet，再运行
+//       fanout_bench [--port=8080] [--subscribers=10000] [--messages=200] [--size=64]
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int SYNC_TIMEOUT_MS = 200;     // 预热轮的等待时间，超时就重发
+constexpr int ROUND_TIMEOUT_MS = 10000;  // 正式轮次的最长等待时间
+
+struct BenchConfig {
+    uint16_t port = 8080;
+    size_t subscribers = 10000;
+    size_t messages = 200;
+    size_t size = 64;  // 每条消息的字节数（含换行符）
+};
+
+// 订阅者状态：只解析每行开头的轮次号
+struct Subscriber {
+    int fd;
+    long last_round = -1;  // 收到的最大轮次号
+    std::string line;      // 尚未收到换行符的半行
+};
+
+int connect_to_server(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "创建 socket 失败");
+    }
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        throw std::system_error(errno, std::generic_category(), "连接服务器失败");
+    }
+    return fd;
+}
+
+// 把文件描述符上限调到硬上限，一万个连接需要超过默认的 1024
+void raise_fd_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+// 读出所有就绪订阅者的数据，返回本轮已收齐的订阅者数
+size_t poll_subscribers(int epoll_fd, std::vector<Subscriber>& subs, long round, size_t done, int timeout_ms) {
+    struct epoll_event events[1024];
+    int ready = epoll_wait(epoll_fd, events, 1024, timeout_ms);
+    char buf[65536];
+    for (int i = 0; i < ready; ++i) {
+        Subscriber& sub = subs[events[i].data.u32];
+        long before = sub.last_round;
+        ssize_t n;
+        while ((n = read(sub.fd, buf, sizeof(buf))) > 0) {
+            std::string_view data(buf, n);
+            size_t pos;
+            while ((pos = data.find('\n')) != std::string_view::npos) {
+                sub.line.append(data.substr(0, pos));
+                sub.last_round = std::max(sub.last_round, std::stol(sub.line));
+                sub.line.clear();
+                data.remove_prefix(pos + 1);
+            }
+            sub.line.append(data);
+        }
+        if (n == 0) {
+            throw std::runtime_error("订阅者连接被服务器断开（可能被判定为慢订阅者）");
+        }
+        if (before < round && sub.last_round >= round) {
+            ++done;
+        }
+    }
+    return done;
+}
+
+// 发一条轮次号为 round 的消息，并等到所有订阅者收到；超时返回 false
+bool run_round(int publisher_fd, int epoll_fd, std::vector<Subscriber>& subs, long round, size_t size,
+               int timeout_ms) {
+    std::string message = std::to_string(round) + " ";
+    message.resize(std::max(size, message.size() + 1) - 1, 'x');
+    message += '\n';
+    if (send(publisher_fd, message.data(), message.size(), 0) != static_cast<ssize_t>(message.size())) {
+        throw std::system_error(errno, std::generic_category(), "发布消息失败");
+    }
+
+    size_t done = 0;
+    for (const Subscriber& sub : subs) {
+        done += sub.last_round >= round;
+    }
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    while (done < subs.size()) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (left <= 0) {
+            return false;
+        }
+        done = poll_subscribers(epoll_fd, subs, round, done, static_cast<int>(left));
+    }
+    return true;
+}
+
+BenchConfig parse_args(int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        std::string value(arg.substr(arg.find('=') + 1));
+        if (arg.starts_with("--port=")) {
+            config.port = static_cast<uint16_t>(std::stoi(value));
+        } else if (arg.starts_with("--subscribers=")) {
+            config.subscribers = std::stoul(value);
+        } else if (arg.starts_with("--messages=")) {
+            config.messages = std::stoul(value);
+        } else if (arg.starts_with("--size=")) {
+            config.size = std::stoul(value);
+        } else {
+            throw std::invalid_argument("未知参数：" + std::string(arg));
+        }
+    }
+    return config;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchConfig config = parse_args(argc, argv);
+        raise_fd_limit();
+
+        // 1. 建立订阅者连接
+        int epoll_fd = epoll_create1(0);
+        std::vector<Subscriber> subs(config.subscribers);
+        for (size_t i = 0; i < subs.size(); ++i) {
+            subs[i].fd = connect_to_server(config.port);
+            fcntl(subs[i].fd, F_SETFL, fcntl(subs[i].fd, F_GETFL) | O_NONBLOCK);
+            struct epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u32 = static_cast<uint32_t>(i);
+            epoll_ctl(epoll_fd, EPOLL_CTL_ADD, subs[i].fd, &ev);
+        }
+        int publisher_fd = connect_to_server(config.port);
+        std::cout << "已建立 " << subs.size() << " 个订阅者连接" << std::endl;
+
+        // 2. 预热：服务器 accept 完所有连接之前发出的消息会有人收不到，重发直到某一轮所有人都收到
+        long round = 0;
+        while (!run_round(publisher_fd, epoll_fd, subs, round, config.size, SYNC_TIMEOUT_MS)) {
+            ++round;
+        }
+
+        // 3. 正式测量
+        std::vector<double> latencies_us;
+        auto start = Clock::now();
+        for (size_t i = 0; i < config.messages; ++i) {
+            ++round;
+            auto t0 = Clock::now();
+            if (!run_round(publisher_fd, epoll_fd, subs, round, config.size, ROUND_TIMEOUT_MS)) {
+                throw std::runtime_error("第 " + std::to_string(round) + " 轮广播超时");
+            }
+            latencies_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+        }
+        double total_s = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::sort(latencies_us.begin(), latencies_us.end());
+        auto percentile = [&](double p) {
+            return latencies_us[static_cast<size_t>(p * (latencies_us.size() - 1))];
+        };
+        double deliveries = static_cast<double>(config.messages) * subs.size();
+        std::cout << "订阅者 " << subs.size() << "，消息 " << config.messages << " 条 x " << config.size << " 字节\n"
+                  << "整轮广播完成时间(us)：p50 " << percentile(0.5) << "，p99 " << percentile(0.99)
+                  << "，max " << latencies_us.back() << "\n"
+                  << "投递速率：" << deliveries / total_s << " 条/秒，"
+                  << deliveries * config.size / total_s / (1024 * 1024) << " MiB/秒" << std::endl;
+
+        for (const Subscriber& sub : subs) {
+            close(sub.fd);
+        }
+        close(publisher_fd);
+        close(epoll_fd);
+    } catch (const std::exception& e) {
+        std::cerr << "压测失败：" << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,371 @@
+// 事件处理函数微基准：不起服务器、不经过网络和 epoll_wait，在一个进程里直接调用
+// handle_read_event / handle_write_event 完成一次"读入 → 回声"，测每批次的耗时、每条消息的内存分配次数和系统调用次数
+// 两种传输：
+//   mock       ：内存里模拟的连接，read/send/epoll_ctl 都不进内核，只剩处理函数和缓冲池本身的开销
+//   socketpair ：AF_UNIX 流 socket 对，真实的系统调用，但不经过 TCP 协议栈
+// 客户端一次连续写入 depth 条 size 字节的消息（流水线深度），服务器处理完后客户端把回声全部读回，算一个批次
+// 用法：handler_bench [--transport=mock|socketpair|all] [--sizes=16,256,4096,65536] [--depths=1,8,32] [--min-time=200]
+// 编译：g++ -std=c++20 -O2 -pthread -o handler_bench bench/handler_bench.cpp（在 adv_EchoServer 目录下执行）
+#include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+ssize_t bench_read(int fd, void* buf, size_t len);
+ssize_t bench_send(int fd, const void* buf, size_t len, int flags);
+int bench_epoll_ctl(int epoll_fd, int op, int fd, struct epoll_event* ev);
+
+// 把服务器里数据路径上的系统调用换成下面的计数/模拟版本，不编译服务器的 main
+#define ECHO_SERVER_NO_MAIN
+#define ECHO_SYS_READ bench_read
+#define ECHO_SYS_SEND bench_send
+#define ECHO_SYS_EPOLL_CTL bench_epoll_ctl
+#include "../server.cpp"
+
+#include <chrono>
+#include <iomanip>
+
+using Clock = std::chrono::steady_clock;
+
+constexpr int MOCK_FD_BASE = 1 << 20;          // 大于这个值的 fd 是模拟连接，不会和真实 fd 冲突
+constexpr int MOCK_EPOLL_FD = MOCK_FD_BASE - 1; // 模拟传输用的"epoll 实例"
+constexpr size_t SOCKETPAIR_MAX_BATCH = 128 * 1024;  // socketpair 的缓冲区放不下更大的批次（客户端是阻塞写完再处理）
+constexpr size_t WARMUP_BATCHES = 200;
+
+// 全局 operator new 计数：缓冲池的堆块、deque 的节点、string 等所有堆分配都经过这里
+uint64_t g_alloc_count = 0;
+
+void* operator new(size_t size) {
+    ++g_alloc_count;
+    if (void* p = std::malloc(size == 0 ? 1 : size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+// 处理函数发出的系统调用次数（模拟传输下是"本该发出"的次数）
+struct SyscallCounts {
+    uint64_t read = 0;
+    uint64_t send = 0;
+    uint64_t epoll_ctl = 0;
+    uint64_t eagain = 0;  // 其中返回 EAGAIN 的 read/send
+
+    uint64_t total() const { return read + send + epoll_ctl; }
+};
+
+SyscallCounts g_syscalls;
+
+// 模拟连接：客户端写入的数据排在 inbound 里，服务器发出的数据只计数（对端永远读得过来）
+struct MockConn {
+    std::vector<char> inbound;
+    size_t inbound_offset = 0;
+    uint64_t received = 0;  // 客户端收到的回声字节数
+};
+
+MockConn g_mock;
+
+ssize_t bench_read(int fd, void* buf, size_t len) {
+    ++g_syscalls.read;
+    if (fd < MOCK_FD_BASE) {
+        ssize_t n = ::read(fd, buf, len);
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            ++g_syscalls.eagain;
+        }
+        return n;
+    }
+    size_t available = g_mock.inbound.size() - g_mock.inbound_offset;
+    if (available == 0) {
+        ++g_syscalls.eagain;
+        errno = EAGAIN;
+        return -1;
+    }
+    size_t n = std::min(len, available);
+    memcpy(buf, g_mock.inbound.data() + g_mock.inbound_offset, n);
+    g_mock.inbound_offset += n;
+    if (g_mock.inbound_offset == g_mock.inbound.size()) {
+        g_mock.inbound.clear();
+        g_mock.inbound_offset = 0;
+    }
+    return static_cast<ssize_t>(n);
+}
+
+ssize_t bench_send(int fd, const void* buf, size_t len, int flags) {
+    ++g_syscalls.send;
+    if (fd < MOCK_FD_BASE) {
+        ssize_t n = ::send(fd, buf, len, flags);
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            ++g_syscalls.eagain;
+        }
+        return n;
+    }
+    g_mock.received += len;
+    return static_cast<ssize_t>(len);
+}
+
+int bench_epoll_ctl(int epoll_fd, int op, int fd, struct epoll_event* ev) {
+    ++g_syscalls.epoll_ctl;
+    if (epoll_fd == MOCK_EPOLL_FD) {
+        return 0;
+    }
+    return ::epoll_ctl(epoll_fd, op, fd, ev);
+}
+
+enum class Transport {
+    Mock,
+    SocketPair,
+};
+
+struct BenchConfig {
+    std::vector<Transport> transports = {Transport::Mock, Transport::SocketPair};
+    std::vector<size_t> sizes = {16, 256, 4096, 65536};
+    std::vector<size_t> depths = {1, 8, 32};
+    double min_time = 0.2;  // 每个用例至少跑多少秒
+};
+
+std::vector<size_t> parse_list(const std::string& value) {
+    std::vector<size_t> result;
+    std::stringstream in(value);
+    std::string item;
+    while (std::getline(in, item, ',')) {
+        result.push_back(std::max<size_t>(1, std::stoul(item)));
+    }
+    if (result.empty()) {
+        throw std::invalid_argument("列表不能为空：" + value);
+    }
+    return result;
+}
+
+BenchConfig parse_bench_args(int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        std::string value(arg.substr(arg.find('=') + 1));
+        if (arg.starts_with("--transport=")) {
+            if (value == "mock") {
+                config.transports = {Transport::Mock};
+            } else if (value == "socketpair") {
+                config.transports = {Transport::SocketPair};
+            } else if (value != "all") {
+                throw std::invalid_argument("未知传输：" + value);
+            }
+        } else if (arg.starts_with("--sizes=")) {
+            config.sizes = parse_list(value);
+        } else if (arg.starts_with("--depths=")) {
+            config.depths = parse_list(value);
+        } else if (arg.starts_with("--min-time=")) {
+            config.min_time = std::stoul(value) / 1000.0;
+        } else {
+            throw std::invalid_argument("未知参数：" + std::string(arg));
+        }
+    }
+    return config;
+}
+
+// 一个用例用到的连接：服务器一端是 ClientData，客户端一端在模拟传输下就是 g_mock
+struct BenchConn {
+    Transport transport;
+    int epoll_fd = MOCK_EPOLL_FD;
+    int client_fd = -1;  // socketpair 的客户端一端
+    ClientData* server = nullptr;
+
+    explicit BenchConn(Transport t) : transport(t) {
+        auto client_data = std::make_unique<ClientData>();
+        client_data->client_ip = "bench";
+        client_data->client_port = 0;
+        if (transport == Transport::Mock) {
+            g_mock = MockConn{};
+            client_data->client_fd = MOCK_FD_BASE;
+        } else {
+            int fds[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == -1) {
+                throw std::system_error(errno, std::generic_category(), "socketpair 失败");
+            }
+            // 两端缓冲区开到系统允许的上限，整个批次能一次放进去
+            int buf = 4 * 1024 * 1024;
+            for (int fd : fds) {
+                setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &buf, sizeof(buf));
+                setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &buf, sizeof(buf));
+            }
+            set_non_blocking(fds[0]);  // 客户端一端保持阻塞写，读回声时用 MSG_DONTWAIT
+            client_data->client_fd = fds[0];
+            client_fd = fds[1];
+            epoll_fd = epoll_create1(0);
+            if (epoll_fd == -1) {
+                throw std::system_error(errno, std::generic_category(), "epoll_create1 失败");
+            }
+        }
+        server = client_data.release();
+        update_events(server, epoll_fd);
+    }
+
+    ~BenchConn() {
+        for (OutChunk& chunk : server->out_queue) {
+            g_buffer_pool.release(chunk.block);
+        }
+        if (transport == Transport::SocketPair) {
+            close(server->client_fd);
+            close(client_fd);
+            close(epoll_fd);
+        }
+        delete server;
+    }
+
+    // 客户端连续写入 depth 条消息
+    void client_send(const std::vector<char>& message, size_t depth) {
+        for (size_t i = 0; i < depth; ++i) {
+            if (transport == Transport::Mock) {
+                g_mock.inbound.insert(g_mock.inbound.end(), message.begin(), message.end());
+                continue;
+            }
+            size_t offset = 0;
+            while (offset < message.size()) {
+                ssize_t n = ::write(client_fd, message.data() + offset, message.size() - offset);
+                if (n == -1) {
+                    throw std::system_error(errno, std::generic_category(), "客户端写入失败");
+                }
+                offset += n;
+            }
+        }
+    }
+
+    // 客户端读走已经到达的回声，返回本次读到的字节数
+    uint64_t client_drain(std::vector<char>& scratch) {
+        if (transport == Transport::Mock) {
+            uint64_t n = g_mock.received;
+            g_mock.received = 0;
+            return n;
+        }
+        uint64_t total = 0;
+        while (true) {
+            ssize_t n = ::recv(client_fd, scratch.data(), scratch.size(), MSG_DONTWAIT);
+            if (n <= 0) {
+                break;
+            }
+            total += n;
+        }
+        return total;
+    }
+
+    // 服务器处理一轮：一次读事件 + 一次写事件（事件循环里写事件由 EPOLLOUT 触发，这里直接调用）
+    void server_round() {
+        if (!handle_read_event(server, epoll_fd) || !handle_write_event(server, epoll_fd)) {
+            throw std::runtime_error("服务器在压测中关闭了连接");
+        }
+    }
+};
+
+struct BenchResult {
+    uint64_t batches = 0;
+    double handler_ns = 0;  // 只算处理函数内部的时间（扣除了取时钟的开销）
+    double wall_seconds = 0;
+    uint64_t allocs = 0;
+    SyscallCounts syscalls;
+};
+
+// 两次连续取时钟的开销，从每轮的计时里扣掉
+double clock_overhead_ns() {
+    constexpr int SAMPLES = 100000;
+    auto start = Clock::now();
+    for (int i = 0; i < SAMPLES; ++i) {
+        auto t0 = Clock::now();
+        auto t1 = Clock::now();
+        asm volatile("" :: "r"(t1 - t0) : "memory");
+    }
+    return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / SAMPLES / 2;
+}
+
+BenchResult run_case(Transport transport, size_t size, size_t depth, double min_time, double overhead_ns) {
+    BenchConn conn(transport);
+    std::vector<char> message(size, 'x');
+    message.back() = '\n';
+    std::vector<char> scratch(256 * 1024);
+    uint64_t expected = static_cast<uint64_t>(size) * depth;
+
+    auto run_batch = [&](double& handler_ns) {
+        conn.client_send(message, depth);
+        uint64_t received = 0;
+        // 超过背压高水位时一轮处理不完，服务器暂停读、写到低水位后恢复，循环到回声全部回来
+        while (received < expected) {
+            auto t0 = Clock::now();
+            conn.server_round();
+            auto t1 = Clock::now();
+            handler_ns += std::chrono::duration<double, std::nano>(t1 - t0).count() - overhead_ns;
+            received += conn.client_drain(scratch);
+        }
+        if (received != expected) {
+            throw std::runtime_error("回声字节数不符");
+        }
+    };
+
+    // 预热：缓冲池攒够空闲块、读缓冲分级调整到位之后再开始计数
+    double ignored = 0;
+    for (size_t i = 0; i < WARMUP_BATCHES; ++i) {
+        run_batch(ignored);
+    }
+
+    BenchResult result;
+    uint64_t allocs_before = g_alloc_count;
+    SyscallCounts syscalls_before = g_syscalls;
+    auto start = Clock::now();
+    do {
+        // 每 64 批检查一次时间，避免取时钟本身摊到结果里太多
+        for (int i = 0; i < 64; ++i) {
+            run_batch(result.handler_ns);
+        }
+        result.batches += 64;
+        result.wall_seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    } while (result.wall_seconds < min_time);
+    result.allocs = g_alloc_count - allocs_before;
+    result.syscalls.read = g_syscalls.read - syscalls_before.read;
+    result.syscalls.send = g_syscalls.send - syscalls_before.send;
+    result.syscalls.epoll_ctl = g_syscalls.epoll_ctl - syscalls_before.epoll_ctl;
+    result.syscalls.eagain = g_syscalls.eagain - syscalls_before.eagain;
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchConfig config = parse_bench_args(argc, argv);
+        // 压测时不打印收发内容；socket 调优关掉，避免 cork 的 setsockopt 混进来
+        g_config.verbose = false;
+        g_config.socket_profile = make_socket_profile("none");
+
+        double overhead_ns = clock_overhead_ns();
+        std::cout << "取时钟开销 " << std::fixed << std::setprecision(1) << overhead_ns << " ns（已从处理耗时中扣除）\n"
+                  << "传输        消息字节  深度    ns/批次   ns/消息    MB/s  分配/消息  syscall/消息"
+                  << "（read / send / epoll_ctl / 其中 EAGAIN）\n";
+        for (Transport transport : config.transports) {
+            const char* name = transport == Transport::Mock ? "mock" : "socketpair";
+            for (size_t size : config.sizes) {
+                for (size_t depth : config.depths) {
+                    std::cout << std::left << std::setw(12) << name << std::right << std::setw(8) << size
+                              << std::setw(6) << depth;
+                    if (transport == Transport::SocketPair && size * depth > SOCKETPAIR_MAX_BATCH) {
+                        std::cout << "  跳过（批次超过 " << SOCKETPAIR_MAX_BATCH / 1024 << "KB）\n";
+                        continue;
+                    }
+                    BenchResult r = run_case(transport, size, depth, config.min_time, overhead_ns);
+                    double messages = static_cast<double>(r.batches * depth);
+                    double per_batch = r.handler_ns / r.batches;
+                    std::cout << std::setprecision(1) << std::setw(11) << per_batch << std::setw(10)
+                              << per_batch / depth << std::setprecision(0) << std::setw(8)
+                              << r.batches * size * depth / (r.handler_ns / 1e9) / 1e6 << std::setprecision(3)
+                              << std::setw(11) << r.allocs / messages << std::setw(14)
+                              << r.syscalls.total() / messages << "（" << r.syscalls.read / messages << " / "
+                              << r.syscalls.send / messages << " / " << r.syscalls.epoll_ctl / messages << " / "
+                              << r.syscalls.eagain / messages << "）\n";
+                }
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "压测失败：" << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,128 @@
+// 请求/应答延迟压测：单连接 ping-pong，统计往返时间分布
+// --split 把每个请求拆成两次 write 发出（客户端开了 TCP_NODELAY，两段会分开到达），
+// 服务器会分两次回复，用来观察服务器端 Nagle + 延迟 ACK 造成的卡顿
+// 用法：latency_bench [--port=8080] [--requests=10000] [--size=32] [--split]
+//       各个 socket 配置的对比见 run_socket_profiles.sh
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+using Clock = std::chrono::steady_clock;
+
+struct BenchConfig {
+    uint16_t port = 8080;
+    size_t requests = 10000;
+    size_t size = 32;
+    bool split = false;
+};
+
+BenchConfig parse_args(int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        std::string value(arg.substr(arg.find('=') + 1));
+        if (arg.starts_with("--port=")) {
+            config.port = static_cast<uint16_t>(std::stoi(value));
+        } else if (arg.starts_with("--requests=")) {
+            config.requests = std::max<size_t>(1, std::stoul(value));
+        } else if (arg.starts_with("--size=")) {
+            config.size = std::max<size_t>(2, std::stoul(value));
+        } else if (arg == "--split") {
+            config.split = true;
+        } else {
+            throw std::invalid_argument("未知参数：" + std::string(arg));
+        }
+    }
+    return config;
+}
+
+void send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, 0);
+        if (n == -1) {
+            throw std::system_error(errno, std::generic_category(), "发送失败");
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+void recv_all(int fd, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, data, len);
+        if (n <= 0) {
+            throw std::system_error(n == 0 ? ECONNRESET : errno, std::generic_category(), "接收失败");
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchConfig config = parse_args(argc, argv);
+
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        if (fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "创建 socket 失败");
+        }
+        struct sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(config.port);
+        inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            throw std::system_error(errno, std::generic_category(), "连接服务器失败");
+        }
+        int opt = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));  // 客户端自己不引入 Nagle 延迟
+
+        std::string request(config.size - 1, 'x');
+        request += '\n';
+        std::string reply(config.size, '\0');
+        std::vector<double> rtts_us;
+        rtts_us.reserve(config.requests);
+
+        for (size_t i = 0; i < config.requests; ++i) {
+            auto t0 = Clock::now();
+            if (config.split) {
+                size_t half = config.size / 2;
+                send_all(fd, request.data(), half);
+                send_all(fd, request.data() + half, config.size - half);
+            } else {
+                send_all(fd, request.data(), config.size);
+            }
+            recv_all(fd, reply.data(), config.size);
+            rtts_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+        }
+        close(fd);
+
+        std::sort(rtts_us.begin(), rtts_us.end());
+        auto percentile = [&](double p) {
+            return rtts_us[static_cast<size_t>(p * (rtts_us.size() - 1))];
+        };
+        double total = 0;
+        for (double rtt : rtts_us) {
+            total += rtt;
+        }
+        std::cout << "请求 " << config.requests << " 次 x " << config.size << " 字节"
+                  << (config.split ? "（分两次写）" : "") << "\n"
+                  << "往返时间(us)：avg " << total / rtts_us.size() << "，p50 " << percentile(0.5)
+                  << "，p90 " << percentile(0.9) << "，p99 " << percentile(0.99)
+                  << "，max " << rtts_us.back() << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "压测失败：" << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
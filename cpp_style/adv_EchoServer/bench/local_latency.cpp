@@ -0,0 +1,201 @@
+// 本机传输延迟对比：同一个服务器分别经 TCP 回环、Unix 域 socket、共享内存环做单连接 ping-pong
+// 服务器需要同时开 --unix 和 --shm，例如：./server --quiet --unix=/tmp/echo.sock --shm=/tmp/echo_shm.sock
+// 用法：local_latency [--port=8080] [--unix=/tmp/echo.sock] [--shm=/tmp/echo_shm.sock]
+//                     [--transports=tcp,unix,shm] [--requests=100000] [--size=32] [--spin=2000] [--ring=262144]
+//       --spin 是共享内存客户端睡眠前的自旋次数，0 表示每次都睡在 eventfd 上（对比纯事件通知的开销）
+//       完整流程见 run_local_latency.sh
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../shm_client.h"
+
+using Clock = std::chrono::steady_clock;
+
+constexpr size_t WARMUP_REQUESTS = 1000;
+
+struct BenchConfig {
+    uint16_t port = 8080;
+    std::string unix_path = "/tmp/echo.sock";
+    std::string shm_path = "/tmp/echo_shm.sock";
+    std::vector<std::string> transports = {"tcp", "unix", "shm"};
+    size_t requests = 100000;
+    size_t size = 32;
+    int spin = SHM_CLIENT_SPIN;
+    uint32_t ring = SHM_CLIENT_RING;
+};
+
+BenchConfig parse_args(int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        std::string value(arg.substr(arg.find('=') + 1));
+        if (arg.starts_with("--port=")) {
+            config.port = static_cast<uint16_t>(std::stoi(value));
+        } else if (arg.starts_with("--unix=")) {
+            config.unix_path = value;
+        } else if (arg.starts_with("--shm=")) {
+            config.shm_path = value;
+        } else if (arg.starts_with("--transports=")) {
+            config.transports.clear();
+            std::stringstream in(value);
+            std::string name;
+            while (std::getline(in, name, ',')) {
+                if (name != "tcp" && name != "unix" && name != "shm") {
+                    throw std::invalid_argument("未知传输：" + name);
+                }
+                config.transports.push_back(name);
+            }
+        } else if (arg.starts_with("--requests=")) {
+            config.requests = std::max<size_t>(1, std::stoul(value));
+        } else if (arg.starts_with("--size=")) {
+            config.size = std::max<size_t>(2, std::stoul(value));
+        } else if (arg.starts_with("--spin=")) {
+            config.spin = std::max(0, std::stoi(value));
+        } else if (arg.starts_with("--ring=")) {
+            config.ring = static_cast<uint32_t>(std::stoul(value));
+        } else {
+            throw std::invalid_argument("未知参数：" + std::string(arg));
+        }
+    }
+    return config;
+}
+
+void send_all(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n == -1) {
+            throw std::system_error(errno, std::generic_category(), "发送失败");
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+void recv_all(int fd, char* data, size_t len) {
+    while (len > 0) {
+        ssize_t n = read(fd, data, len);
+        if (n <= 0) {
+            throw std::system_error(n == 0 ? ECONNRESET : errno, std::generic_category(), "接收失败");
+        }
+        data += n;
+        len -= n;
+    }
+}
+
+int connect_tcp(uint16_t port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "创建 socket 失败");
+    }
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "连接 TCP 服务器失败");
+    }
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    return fd;
+}
+
+int connect_unix(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "创建 Unix socket 失败");
+    }
+    struct sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "连接 Unix socket 失败：" + path);
+    }
+    return fd;
+}
+
+// 跑一组 ping-pong：round_trip 发一个请求并收齐回声，返回排好序的往返时间（微秒）
+std::vector<double> run_pingpong(const BenchConfig& config, const std::function<void()>& round_trip) {
+    for (size_t i = 0; i < WARMUP_REQUESTS; ++i) {
+        round_trip();
+    }
+    std::vector<double> rtts_us;
+    rtts_us.reserve(config.requests);
+    for (size_t i = 0; i < config.requests; ++i) {
+        auto t0 = Clock::now();
+        round_trip();
+        rtts_us.push_back(std::chrono::duration<double, std::micro>(Clock::now() - t0).count());
+    }
+    std::sort(rtts_us.begin(), rtts_us.end());
+    return rtts_us;
+}
+
+void print_result(const std::string& name, const std::vector<double>& rtts_us, const std::string& extra) {
+    auto percentile = [&](double p) {
+        return rtts_us[static_cast<size_t>(p * (rtts_us.size() - 1))];
+    };
+    double total = 0;
+    for (double rtt : rtts_us) {
+        total += rtt;
+    }
+    std::cout << name << "：avg " << total / rtts_us.size() << "，p50 " << percentile(0.5)
+              << "，p90 " << percentile(0.9) << "，p99 " << percentile(0.99)
+              << "，p99.9 " << percentile(0.999) << "，max " << rtts_us.back()
+              << "，" << rtts_us.size() / (total / 1e6) << " 次/秒" << extra << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        BenchConfig config = parse_args(argc, argv);
+        std::string request(config.size - 1, 'x');
+        request += '\n';
+        std::string reply(config.size, '\0');
+
+        std::cout << "请求 " << config.requests << " 次 x " << config.size << " 字节，往返时间(us)" << std::endl;
+        for (const std::string& transport : config.transports) {
+            if (transport == "shm") {
+                ShmClient client;
+                client.connect(config.shm_path, config.ring, config.spin);
+                auto rtts = run_pingpong(config, [&] {
+                    client.exchange(request.data(), reply.data(), request.size());
+                });
+                // 统计含预热的请求，只看量级
+                double total = static_cast<double>(config.requests + WARMUP_REQUESTS);
+                std::ostringstream extra;
+                extra << "（每次请求叫醒服务器 " << client.get_signals() / total << " 次，睡眠 "
+                      << client.get_sleeps() / total << " 次，自旋 " << config.spin << "）";
+                print_result("shm ", rtts, extra.str());
+                continue;
+            }
+            int fd = transport == "tcp" ? connect_tcp(config.port) : connect_unix(config.unix_path);
+            auto rtts = run_pingpong(config, [&] {
+                send_all(fd, request.data(), request.size());
+                recv_all(fd, reply.data(), reply.size());
+            });
+            close(fd);
+            print_result(transport, rtts, "");
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "压测失败：" << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
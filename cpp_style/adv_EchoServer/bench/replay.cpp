@@ -0,0 +1,426 @@
+// 流量重放：读入 server --capture 写出的抓取日志，按原来的连接和时间节奏把客户端数据重新发给服务器
+// 对四个回声服务器都适用（只需要服务器把收到的字节原样发回，或者像 room/offload 模式那样按行处理）；
+// Simple_EchoServer 只服务一个客户端就退出，只能重放单连接的抓取
+// 抓取时没保存数据（或数据被截断）的部分用 'x' 填充，每次读事件的数据以换行结尾，按行处理的模式也能用
+// 回显延迟按字节对应估算：某次发送的最后一个字节被收回的时间减去发送时间，只对回声服务器有意义
+// 用法：replay --file=抓取日志 [--host=127.0.0.1] [--port=8080] [--speed=1.0] [--fast] [--drain-timeout=5000]
+//       --speed 按倍数压缩时间间隔，--fast 忽略时间戳尽快发送（仍保持每个连接内部的顺序）
+//       --drain-timeout 日志放完后，服务器超过这么多毫秒没有任何动静就结束
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <chrono>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "../capture_log.h"
+
+using Clock = std::chrono::steady_clock;
+
+struct ReplayConfig {
+    std::string file;
+    std::string host = "127.0.0.1";
+    uint16_t port = 8080;
+    double speed = 1.0;
+    bool fast = false;
+    int drain_timeout_ms = 5000;  // 日志放完后，服务器多久没有动静就不再等待
+};
+
+// 日志里的一个事件（payload 直接指向映射的文件）
+struct ReplayEvent {
+    uint64_t time_ns;
+    uint32_t conn_id;
+    CaptureEvent type;
+    uint32_t length;
+    const char* payload;
+    uint32_t payload_len;
+};
+
+struct ReplayConn {
+    int fd = -1;
+    bool opened = false;       // 日志里出现过 Open（连接失败的也算）
+    bool closing = false;      // 日志里出现了 Close，发完剩余数据、收齐回复后关闭写端
+    bool shut = false;         // 已关闭写端
+    bool connecting = false;   // 非阻塞 connect 还没完成
+    bool want_write = false;   // 是否注册了 EPOLLOUT
+    std::string out;           // 待发送的数据
+    size_t out_offset = 0;
+    uint64_t queued = 0;       // 累计放进发送队列的字节数
+    uint64_t received = 0;     // 累计收到的字节数
+    uint64_t expected = 0;     // 抓取时服务器在这个连接上已写出的字节数
+    std::deque<std::pair<uint64_t, Clock::time_point>> pending;  // (发送后累计字节数, 放入队列的时间)
+};
+
+struct ReplayStats {
+    uint64_t connections = 0;
+    uint64_t connect_failures = 0;
+    uint64_t events = 0;
+    uint64_t bytes_sent = 0;
+    uint64_t bytes_received = 0;
+    uint64_t bytes_expected = 0;  // 抓取时服务器写出的字节数
+    std::vector<double> lateness_us;  // 事件实际发出时间比计划晚多少
+    std::vector<double> echo_us;      // 按字节对应估算的回显延迟
+};
+
+ReplayConfig parse_args(int argc, char* argv[]) {
+    ReplayConfig config;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        std::string value(arg.substr(arg.find('=') + 1));
+        if (arg.starts_with("--file=")) {
+            config.file = value;
+        } else if (arg.starts_with("--host=")) {
+            config.host = value;
+        } else if (arg.starts_with("--port=")) {
+            config.port = static_cast<uint16_t>(std::stoi(value));
+        } else if (arg.starts_with("--speed=")) {
+            config.speed = std::stod(value);
+            if (config.speed <= 0) {
+                throw std::invalid_argument("--speed 必须大于 0");
+            }
+        } else if (arg == "--fast") {
+            config.fast = true;
+        } else if (arg.starts_with("--drain-timeout=")) {
+            config.drain_timeout_ms = std::stoi(value);
+        } else {
+            throw std::invalid_argument("未知参数：" + std::string(arg));
+        }
+    }
+    if (config.file.empty()) {
+        throw std::invalid_argument("缺少 --file=抓取日志");
+    }
+    return config;
+}
+
+// 把抓取日志映射进内存并读出所有事件，按时间排序（同一时间戳保持日志里的顺序）
+std::vector<ReplayEvent> load_capture(const std::string& path, uint32_t& max_conn_id) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "打开抓取日志失败：" + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        int err = errno;
+        close(fd);
+        throw std::system_error(err, std::generic_category(), "读取抓取日志大小失败");
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size < sizeof(CaptureHeader)) {
+        close(fd);
+        throw std::runtime_error("抓取日志太短：" + path);
+    }
+    // 映射在进程结束前一直保留，事件的 payload 指向这里
+    void* addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    int err = errno;
+    close(fd);
+    if (addr == MAP_FAILED) {
+        throw std::system_error(err, std::generic_category(), "映射抓取日志失败");
+    }
+    const char* base = static_cast<const char*>(addr);
+    CaptureHeader header;
+    memcpy(&header, base, sizeof(header));
+    if (memcmp(header.magic, CAPTURE_MAGIC, sizeof(header.magic)) != 0 || header.version != CAPTURE_VERSION) {
+        throw std::runtime_error("不是可识别的抓取日志：" + path);
+    }
+
+    std::vector<ReplayEvent> events;
+    max_conn_id = 0;
+    size_t offset = header.header_size;
+    while (offset + sizeof(CaptureRecord) <= size) {
+        const auto* record = reinterpret_cast<const CaptureRecord*>(base + offset);
+        if (record->type == static_cast<uint8_t>(CaptureEvent::End) ||
+            offset + capture_record_size(record->payload_len) > size) {
+            break;
+        }
+        events.push_back({record->time_ns, record->conn_id, static_cast<CaptureEvent>(record->type),
+                          record->length, reinterpret_cast<const char*>(record + 1), record->payload_len});
+        max_conn_id = std::max(max_conn_id, record->conn_id);
+        offset += capture_record_size(record->payload_len);
+    }
+    std::stable_sort(events.begin(), events.end(),
+                     [](const ReplayEvent& a, const ReplayEvent& b) { return a.time_ns < b.time_ns; });
+    return events;
+}
+
+void raise_fd_limit() {
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+void update_interest(int epoll_fd, ReplayConn& conn, size_t index) {
+    bool want_write = conn.connecting || conn.out_offset < conn.out.size();
+    if (want_write == conn.want_write) {
+        return;
+    }
+    struct epoll_event ev{};
+    ev.events = want_write ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    ev.data.u64 = index;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, conn.fd, &ev);
+    conn.want_write = want_write;
+}
+
+// 日志要求关闭时，等数据发完、服务器的回复也收齐（抓取时写出的字节数）再关闭写端：
+// 服务器读到 EOF 就会关闭连接，提前关闭写端会让 --fast 模式下还没回完的数据被丢掉
+void maybe_shutdown(ReplayConn& conn) {
+    if (conn.closing && !conn.shut && conn.out.empty() && conn.received >= conn.expected) {
+        shutdown(conn.fd, SHUT_WR);
+        conn.shut = true;
+    }
+}
+
+// 尽量发送待发送队列
+void flush_conn(int epoll_fd, ReplayConn& conn, size_t index, ReplayStats& stats) {
+    if (conn.connecting) {
+        return;  // 连接建立后由 EPOLLOUT 触发发送
+    }
+    while (conn.out_offset < conn.out.size()) {
+        ssize_t n = send(conn.fd, conn.out.data() + conn.out_offset, conn.out.size() - conn.out_offset, MSG_NOSIGNAL);
+        if (n == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                break;
+            }
+            conn.out.clear();
+            conn.out_offset = 0;
+            break;  // 连接出错，等读端报告断开
+        }
+        conn.out_offset += n;
+        stats.bytes_sent += n;
+    }
+    if (conn.out_offset == conn.out.size()) {
+        conn.out.clear();
+        conn.out_offset = 0;
+    }
+    maybe_shutdown(conn);
+    update_interest(epoll_fd, conn, index);
+}
+
+void open_conn(int epoll_fd, const ReplayConfig& config, ReplayConn& conn, size_t index, ReplayStats& stats) {
+    conn.opened = true;
+    ++stats.connections;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "创建 socket 失败");
+    }
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(config.port);
+    inet_pton(AF_INET, config.host.c_str(), &addr.sin_addr);
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    // 非阻塞 connect：服务器 accept 得慢（比如一次只服务一个客户端）时不能卡住其他连接
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        if (errno != EINPROGRESS) {
+            close(fd);
+            ++stats.connect_failures;
+            return;
+        }
+        conn.connecting = true;
+    }
+    struct epoll_event ev{};
+    ev.events = conn.connecting ? EPOLLIN | EPOLLOUT : EPOLLIN;
+    ev.data.u64 = index;
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        throw std::system_error(errno, std::generic_category(), "epoll_ctl 添加连接失败");
+    }
+    conn.want_write = conn.connecting;
+    conn.fd = fd;
+}
+
+// 非阻塞 connect 完成（EPOLLOUT），失败时返回 false
+bool finish_connect(ReplayConn& conn, ReplayStats& stats) {
+    int err = 0;
+    socklen_t len = sizeof(err);
+    getsockopt(conn.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+    conn.connecting = false;
+    if (err != 0) {
+        ++stats.connect_failures;
+        return false;
+    }
+    return true;
+}
+
+void close_conn(int epoll_fd, ReplayConn& conn, size_t& active) {
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, conn.fd, nullptr);
+    close(conn.fd);
+    conn.fd = -1;
+    --active;
+}
+
+// 读出服务器回的数据，按累计字节数对上之前的发送，估算回显延迟；服务器关闭连接时返回 false
+bool drain_conn(ReplayConn& conn, ReplayStats& stats) {
+    char buf[65536];
+    while (true) {
+        ssize_t n = read(conn.fd, buf, sizeof(buf));
+        if (n > 0) {
+            conn.received += n;
+            stats.bytes_received += n;
+            auto now = Clock::now();
+            while (!conn.pending.empty() && conn.pending.front().first <= conn.received) {
+                stats.echo_us.push_back(
+                    std::chrono::duration<double, std::micro>(now - conn.pending.front().second).count());
+                conn.pending.pop_front();
+            }
+            continue;
+        }
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        return false;  // EOF 或出错
+    }
+}
+
+void print_distribution(const char* name, std::vector<double>& values) {
+    if (values.empty()) {
+        return;
+    }
+    std::sort(values.begin(), values.end());
+    auto percentile = [&](double p) { return values[static_cast<size_t>(p * (values.size() - 1))]; };
+    double total = 0;
+    for (double value : values) {
+        total += value;
+    }
+    std::cout << name << "(us)：样本 " << values.size() << "，avg " << total / values.size()
+              << "，p50 " << percentile(0.5) << "，p90 " << percentile(0.9)
+              << "，p99 " << percentile(0.99) << "，max " << values.back() << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        ReplayConfig config = parse_args(argc, argv);
+        uint32_t max_conn_id = 0;
+        std::vector<ReplayEvent> events = load_capture(config.file, max_conn_id);
+        if (events.empty()) {
+            std::cout << "抓取日志里没有事件" << std::endl;
+            return 0;
+        }
+        raise_fd_limit();
+
+        int epoll_fd = epoll_create1(0);
+        if (epoll_fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "epoll_create1 失败");
+        }
+        std::vector<ReplayConn> conns(max_conn_id + 1);
+        ReplayStats stats;
+        size_t active = 0;
+        size_t next = 0;
+        auto start = Clock::now();
+        auto last_progress = start;  // 最近一次放出事件或收发数据的时间
+        struct epoll_event ready[1024];
+
+        while (next < events.size() || active > 0) {
+            auto now = Clock::now();
+            uint64_t elapsed_ns = static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - start).count() * config.speed);
+
+            // 1. 把到期的事件放出去
+            while (next < events.size() && (config.fast || events[next].time_ns <= elapsed_ns)) {
+                const ReplayEvent& event = events[next++];
+                ReplayConn& conn = conns[event.conn_id];
+                ++stats.events;
+                last_progress = now;
+                if (!config.fast) {
+                    stats.lateness_us.push_back((elapsed_ns - event.time_ns) / config.speed / 1000.0);
+                }
+                if (event.type == CaptureEvent::Open) {
+                    open_conn(epoll_fd, config, conn, event.conn_id, stats);
+                    active += conn.fd != -1;
+                    continue;
+                }
+                if (conn.fd == -1) {
+                    continue;  // 连接失败、已被服务器关闭，或日志开始前就已建立的连接
+                }
+                if (event.type == CaptureEvent::Read) {
+                    conn.out.append(event.payload, event.payload_len);
+                    if (event.length > event.payload_len) {
+                        conn.out.append(event.length - event.payload_len - 1, 'x');
+                        conn.out.push_back('\n');
+                    }
+                    conn.queued += event.length;
+                    conn.pending.emplace_back(conn.queued, now);
+                    flush_conn(epoll_fd, conn, event.conn_id, stats);
+                } else if (event.type == CaptureEvent::Write) {
+                    conn.expected += event.length;
+                    stats.bytes_expected += event.length;
+                } else if (event.type == CaptureEvent::Close) {
+                    conn.closing = true;
+                    flush_conn(epoll_fd, conn, event.conn_id, stats);
+                }
+            }
+
+            // 2. 等到下一个事件到期，或者处理服务器的回复
+            int timeout_ms = 100;
+            if (next < events.size()) {
+                uint64_t wait_ns = static_cast<uint64_t>((events[next].time_ns - elapsed_ns) / config.speed);
+                timeout_ms = static_cast<int>(std::min<uint64_t>(wait_ns / 1000000, 100));
+            } else if (now - last_progress > std::chrono::milliseconds(config.drain_timeout_ms)) {
+                break;  // 日志放完后服务器迟迟没有动静，剩下的连接不再等待
+            }
+            int n = epoll_wait(epoll_fd, ready, 1024, timeout_ms);
+            if (n == -1 && errno != EINTR) {
+                throw std::system_error(errno, std::generic_category(), "epoll_wait 失败");
+            }
+            if (n > 0) {
+                last_progress = Clock::now();
+            }
+            for (int i = 0; i < n; ++i) {
+                size_t index = ready[i].data.u64;
+                ReplayConn& conn = conns[index];
+                if (conn.fd == -1) {
+                    continue;
+                }
+                if (conn.connecting) {
+                    if (!finish_connect(conn, stats)) {
+                        close_conn(epoll_fd, conn, active);
+                        continue;
+                    }
+                    flush_conn(epoll_fd, conn, index, stats);
+                    continue;
+                }
+                if (ready[i].events & EPOLLOUT) {
+                    flush_conn(epoll_fd, conn, index, stats);
+                }
+                if (ready[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    if (!drain_conn(conn, stats)) {
+                        close_conn(epoll_fd, conn, active);
+                    } else {
+                        maybe_shutdown(conn);
+                    }
+                }
+            }
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::cout << "重放 " << config.file << "：事件 " << stats.events << "，连接 " << stats.connections
+                  << "（失败 " << stats.connect_failures << "，超时未关闭 " << active << "）\n"
+                  << "抓取时长 " << events.back().time_ns / 1e9 << " s，重放耗时 " << seconds << " s"
+                  << (config.fast ? "（--fast）" : "") << "\n"
+                  << "发送 " << stats.bytes_sent << " 字节，收到 " << stats.bytes_received
+                  << " 字节（抓取时服务器写出 " << stats.bytes_expected << " 字节），吞吐 "
+                  << stats.bytes_sent / seconds / 1e6 << " MB/s\n";
+        print_distribution("事件发出延迟", stats.lateness_us);
+        print_distribution("回显延迟", stats.echo_us);
+        close(epoll_fd);
+    } catch (const std::exception& e) {
+        std::cerr << "重放失败：" << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
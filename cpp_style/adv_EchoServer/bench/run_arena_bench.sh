@@ -0,0 +1,17 @@
+#!/bin/bash
+# 依次用堆分配和各种 arena 页类型跑 arena_bench，对比吞吐和 dTLB miss
+# 用法：bench/run_arena_bench.sh [连接数] [操作次数]（在 adv_EchoServer 目录下执行）
+# hugetlb 需要先预留大页，例如：echo 512 | sudo tee /proc/sys/vm/nr_hugepages
+set -e
+
+CONNECTIONS=${1:-50000}
+OPS=${2:-10000000}
+BUILD_DIR=$(mktemp -d)
+trap 'rm -rf "$BUILD_DIR"' EXIT
+
+g++ -std=c++20 -O2 -o "$BUILD_DIR/arena_bench" bench/arena_bench.cpp
+
+for pages in heap none thp hugetlb; do
+    echo "===== pages=$pages ====="
+    "$BUILD_DIR/arena_bench" --pages="$pages" --connections="$CONNECTIONS" --ops="$OPS" --size=512
+done
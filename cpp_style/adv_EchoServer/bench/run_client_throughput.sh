@@ -0,0 +1,25 @@
+#!/bin/bash
+# 启动服务器（TCP + Unix socket），分别经两种传输对比阻塞客户端和 AsyncClient 的吞吐
+# 用法：bench/run_client_throughput.sh [端口] [请求次数]（在 adv_EchoServer 目录下执行）
+# 换成别的服务器做对端时，直接运行 client_throughput 并用 --endpoint 指向它
+set -e
+
+PORT=${1:-18080}
+REQUESTS=${2:-200000}
+BUILD_DIR=$(mktemp -d)
+UNIX_PATH="$BUILD_DIR/echo.sock"
+
+g++ -std=c++20 -O2 -pthread -o "$BUILD_DIR/server" server.cpp
+g++ -std=c++20 -O2 -pthread -o "$BUILD_DIR/client_throughput" bench/client_throughput.cpp
+
+"$BUILD_DIR/server" --port="$PORT" --quiet --unix="$UNIX_PATH" > /dev/null &
+server_pid=$!
+trap 'kill "$server_pid" 2> /dev/null; rm -rf "$BUILD_DIR"' EXIT
+sleep 0.3
+
+for endpoint in "127.0.0.1:$PORT" "unix:$UNIX_PATH"; do
+    echo "===== $endpoint ====="
+    "$BUILD_DIR/client_throughput" --endpoint="$endpoint" --requests="$REQUESTS" --size=32
+    "$BUILD_DIR/client_throughput" --endpoint="$endpoint" --requests="$REQUESTS" --size=32 --depth=1 \
+        --modes=callback
+done
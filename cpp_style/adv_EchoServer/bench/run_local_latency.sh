@@ -0,0 +1,27 @@
+#!/bin/bash
+# 启动同时监听 TCP、Unix socket 和共享内存握手 socket 的服务器，对比三种本机传输的往返延迟
+# 共享内存分别跑自旋等待和每次都睡在 eventfd 上两组
+# 用法：bench/run_local_latency.sh [端口] [请求次数]（在 adv_EchoServer 目录下执行）
+set -e
+
+PORT=${1:-18080}
+REQUESTS=${2:-100000}
+BUILD_DIR=$(mktemp -d)
+UNIX_PATH="$BUILD_DIR/echo.sock"
+SHM_PATH="$BUILD_DIR/echo_shm.sock"
+
+g++ -std=c++20 -O2 -pthread -o "$BUILD_DIR/server" server.cpp
+g++ -std=c++20 -O2 -o "$BUILD_DIR/local_latency" bench/local_latency.cpp
+
+"$BUILD_DIR/server" --port="$PORT" --quiet --unix="$UNIX_PATH" --shm="$SHM_PATH" > /dev/null &
+server_pid=$!
+trap 'kill "$server_pid" 2> /dev/null; rm -rf "$BUILD_DIR"' EXIT
+sleep 0.3
+
+for size in 32 4096; do
+    echo "===== size=$size ====="
+    "$BUILD_DIR/local_latency" --port="$PORT" --unix="$UNIX_PATH" --shm="$SHM_PATH" \
+        --requests="$REQUESTS" --size="$size"
+    "$BUILD_DIR/local_latency" --port="$PORT" --shm="$SHM_PATH" --transports=shm \
+        --requests="$REQUESTS" --size="$size" --spin=0
+done
@@ -0,0 +1,23 @@
+#!/bin/bash
+# 依次用每个 socket 配置启动服务器，跑整包请求和拆包请求两组延迟压测
+# 用法：bench/run_socket_profiles.sh [端口]（在 adv_EchoServer 目录下执行）
+set -e
+
+PORT=${1:-18080}
+BUILD_DIR=$(mktemp -d)
+trap 'rm -rf "$BUILD_DIR"' EXIT
+
+g++ -std=c++20 -O2 -pthread -o "$BUILD_DIR/server" server.cpp
+g++ -std=c++20 -O2 -o "$BUILD_DIR/latency_bench" bench/latency_bench.cpp
+
+for profile in none latency throughput; do
+    "$BUILD_DIR/server" --port="$PORT" --quiet --socket-profile="$profile" > /dev/null &
+    server_pid=$!
+    sleep 0.3
+    echo "===== socket-profile=$profile ====="
+    "$BUILD_DIR/latency_bench" --port="$PORT" --requests=2000 --size=32
+    "$BUILD_DIR/latency_bench" --port="$PORT" --requests=200 --size=32 --split
+    "$BUILD_DIR/latency_bench" --port="$PORT" --requests=2000 --size=16384
+    kill "$server_pid"
+    wait "$server_pid" 2> /dev/null || true
+done
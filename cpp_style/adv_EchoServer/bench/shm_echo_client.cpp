@@ -0,0 +1,47 @@
+// 共享内存传输的回声客户端：从标准输入逐行读，经共享内存环发给服务器，打印收到的回声
+// 服务器需要开启 --shm，例如：./server --shm=/tmp/echo_shm.sock
+// 用法：shm_echo_client [--shm=/tmp/echo_shm.sock] [--ring=262144]，输入 quit 退出
+#include <iostream>
+#include <string>
+#include <string_view>
+
+#include "../shm_client.h"
+
+int main(int argc, char* argv[]) {
+    try {
+        std::string path = "/tmp/echo_shm.sock";
+        uint32_t ring = SHM_CLIENT_RING;
+        for (int i = 1; i < argc; ++i) {
+            std::string_view arg = argv[i];
+            std::string value(arg.substr(arg.find('=') + 1));
+            if (arg.starts_with("--shm=")) {
+                path = value;
+            } else if (arg.starts_with("--ring=")) {
+                ring = static_cast<uint32_t>(std::stoul(value));
+            } else {
+                throw std::invalid_argument("未知参数：" + std::string(arg));
+            }
+        }
+
+        ShmClient client;
+        client.connect(path, ring);
+        std::cout << "成功与服务端建立共享内存会话（环大小 " << ring << "）" << std::endl;
+        std::cout << "输入quit退出" << std::endl;
+
+        std::string line;
+        std::string reply;
+        while (std::cout << " > " << std::flush, std::getline(std::cin, line)) {
+            if (line == "quit") {
+                break;
+            }
+            line += '\n';
+            reply.resize(line.size());
+            client.exchange(line.data(), reply.data(), line.size());
+            std::cout << "收到服务端回声：" << reply;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "客户端异常退出：" << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,413 @@
+#pragma once
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <system_error>
+#include <sys/mman.h>
+
+constexpr size_t IO_BLOCK_SIZE = 64 * 1024;  // 最大一级标准块（一个块可承载一次完整的大回复）
+
+// 标准块的大小分级：取块时按需要的容量选最小的一级，超过最大一级的单独分配
+constexpr size_t SIZE_CLASSES[] = {1024, 4 * 1024, 16 * 1024, IO_BLOCK_SIZE};
+constexpr uint8_t SIZE_CLASS_COUNT = sizeof(SIZE_CLASSES) / sizeof(SIZE_CLASSES[0]);
+constexpr uint8_t OVERSIZE_CLASS = 0xFF;  // 超大块的分级标记
+
+// 找到容量不小于 capacity 的最小分级，超过最大一级时返回 OVERSIZE_CLASS
+inline uint8_t size_class_for(size_t capacity) {
+    for (uint8_t i = 0; i < SIZE_CLASS_COUNT; ++i) {
+        if (capacity <= SIZE_CLASSES[i]) {
+            return i;
+        }
+    }
+    return OVERSIZE_CLASS;
+}
+
+// 全局内存账本：所有线程的缓冲池共用一份，limit 为 0 表示不限制
+struct MemoryBudget {
+    std::atomic<size_t> reserved{0};  // 从系统申请的字节数（含空闲链表里的块）
+    std::atomic<size_t> in_use{0};    // 正被连接引用的字节数
+    size_t limit = 0;                 // 预算上限（启动时设置，之后只读）
+
+    bool exceeded() const { return limit != 0 && reserved.load(std::memory_order_relaxed) >= limit; }
+};
+
+inline MemoryBudget g_memory_budget;
+
+constexpr uint32_t NO_SLAB = UINT32_MAX;  // 块不在 arena 里（从堆上单独分配）
+
+// I/O 缓冲块：数据区 + 引用计数
+// 引用计数归零前块不会被复用，MSG_ZEROCOPY 发送时靠它把数据钉住直到内核通知完成
+struct IoBlock {
+    char* data;           // 数据区
+    IoBlock* next_free;   // 空闲链表指针（仅在池中时有效）
+    uint32_t capacity;    // 数据区容量
+    uint32_t size;        // 已写入的有效数据长度
+    uint32_t refcnt;      // 引用计数
+    uint32_t slab;        // 所在的 arena slab（NO_SLAB 表示堆上分配的块）
+    uint8_t size_class;   // 所属分级（OVERSIZE_CLASS 表示超大块）
+
+    size_t space() const { return capacity - size; }
+};
+
+constexpr size_t SLAB_SIZE = IO_BLOCK_SIZE;                            // arena 的分配单位：一个最大一级的块
+constexpr size_t SLAB_MAX_BLOCKS = SLAB_SIZE / SIZE_CLASSES[0];         // 一个 slab 最多切成多少块
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+// arena 的页类型
+enum class ArenaPages {
+    Auto,         // 依次尝试 HugeTlb、Transparent，都不行时用普通页
+    HugeTlb,      // MAP_HUGETLB：需要预留大页（/proc/sys/vm/nr_hugepages）
+    Transparent,  // 普通映射 + MADV_HUGEPAGE，由内核尽量合并成透明大页
+    Regular,      // 普通 4K 页
+};
+
+// slab 的切分状态（只有持有它的缓冲池线程访问）
+struct SlabInfo {
+    uint16_t block_count;  // 切成的块数
+    uint16_t free_count;   // 在持有者空闲链表里的块数，等于 block_count 时整个 slab 可以还给 arena
+    bool releasing;        // trim 正在把它的块从空闲链表摘下来
+};
+
+// 缓冲块 arena：启动时一次性 mmap 并预先缺页，优先用大页，切成固定 64K 的 slab
+// 数据区在前、所有块头集中在后面，读写路径上访问的内存都落在少数几个大页里，减少 dTLB miss
+// slab 的空闲链表是无锁栈（所有 reactor 共用），块头按 slab 编号预留好，取还 slab 不需要分配内存
+class BlockArena {
+private:
+    char* map_base = nullptr;       // mmap 返回的地址（含对齐用的余量）
+    size_t map_bytes = 0;
+    char* slab_base = nullptr;      // 第一个 slab 的地址（按大页对齐）
+    IoBlock* headers = nullptr;     // 块头区：每个 slab 预留 SLAB_MAX_BLOCKS 个
+    uint32_t slab_count = 0;
+    std::unique_ptr<SlabInfo[]> infos;
+    std::unique_ptr<std::atomic<uint32_t>[]> next;  // 无锁栈的后继
+    std::atomic<uint64_t> head{NO_SLAB};            // 低 32 位栈顶 slab，高 32 位版本号（防 ABA）
+    std::atomic<uint32_t> free_slabs{0};
+    ArenaPages pages = ArenaPages::Regular;
+    bool locked = false;
+
+    // 尝试按指定页类型映射 bytes 字节，成功时设置 map_base / slab_base
+    bool map(size_t bytes, ArenaPages type) {
+        if (type == ArenaPages::HugeTlb) {
+            void* addr = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+            if (addr == MAP_FAILED) {
+                return false;
+            }
+            map_base = slab_base = static_cast<char*>(addr);
+            map_bytes = bytes;
+            return true;
+        }
+        // 多映射一个大页的余量，把起始地址对齐到大页边界，透明大页才能整页合并
+        size_t padded = bytes + HUGE_PAGE_SIZE;
+        void* addr = mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap 缓冲块 arena 失败");
+        }
+        map_base = static_cast<char*>(addr);
+        map_bytes = padded;
+        slab_base = reinterpret_cast<char*>(
+            (reinterpret_cast<uintptr_t>(map_base) + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1));
+        if (type == ArenaPages::Transparent && madvise(slab_base, bytes, MADV_HUGEPAGE) == -1) {
+            munmap(map_base, map_bytes);
+            map_base = slab_base = nullptr;
+            return false;
+        }
+        // 预先缺页：每页写一个字节，之后读写路径上不会再缺页
+        for (size_t offset = 0; offset < bytes; offset += 4096) {
+            slab_base[offset] = 0;
+        }
+        return true;
+    }
+
+public:
+    BlockArena() = default;
+    BlockArena(const BlockArena&) = delete;
+    BlockArena& operator=(const BlockArena&) = delete;
+
+    ~BlockArena() {
+        if (map_base != nullptr) {
+            munmap(map_base, map_bytes);
+        }
+    }
+
+    // 预留 bytes 字节（向上取整到大页），必须在任何缓冲池取块之前调用
+    // 要求的页类型不可用时依次退到透明大页、普通页，返回实际使用的页类型；普通页也映射失败时抛异常
+    ArenaPages init(size_t bytes, ArenaPages type, bool lock_memory) {
+        size_t slabs = (bytes + SLAB_SIZE - 1) / SLAB_SIZE;
+        size_t total = slabs * SLAB_SIZE + slabs * SLAB_MAX_BLOCKS * sizeof(IoBlock);
+        total = (total + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+        slabs = total / (SLAB_SIZE + SLAB_MAX_BLOCKS * sizeof(IoBlock));  // 取整后多出来的空间也切成 slab
+
+        if ((type == ArenaPages::Auto || type == ArenaPages::HugeTlb) && map(total, ArenaPages::HugeTlb)) {
+            pages = ArenaPages::HugeTlb;
+        } else if (type != ArenaPages::Regular && map(total, ArenaPages::Transparent)) {
+            pages = ArenaPages::Transparent;
+        } else {
+            map(total, ArenaPages::Regular);
+            pages = ArenaPages::Regular;
+        }
+        locked = lock_memory && mlock(slab_base, total) == 0;
+
+        slab_count = static_cast<uint32_t>(slabs);
+        headers = reinterpret_cast<IoBlock*>(slab_base + slabs * SLAB_SIZE);
+        infos = std::make_unique<SlabInfo[]>(slabs);
+        next = std::make_unique<std::atomic<uint32_t>[]>(slabs);
+        // 按地址顺序入栈，先取出的 slab 地址相邻
+        for (uint32_t i = slab_count; i-- > 0;) {
+            release_slab(i);
+        }
+        return pages;
+    }
+
+    bool enabled() const { return slab_count != 0; }
+
+    // 取一个空闲 slab，arena 用完时返回 NO_SLAB
+    uint32_t acquire_slab() {
+        uint64_t old_head = head.load(std::memory_order_acquire);
+        while (true) {
+            uint32_t index = static_cast<uint32_t>(old_head);
+            if (index == NO_SLAB) {
+                return NO_SLAB;
+            }
+            uint64_t new_head = ((old_head >> 32) + 1) << 32 | next[index].load(std::memory_order_relaxed);
+            if (head.compare_exchange_weak(old_head, new_head, std::memory_order_acquire)) {
+                free_slabs.fetch_sub(1, std::memory_order_relaxed);
+                return index;
+            }
+        }
+    }
+
+    void release_slab(uint32_t index) {
+        uint64_t old_head = head.load(std::memory_order_relaxed);
+        while (true) {
+            next[index].store(static_cast<uint32_t>(old_head), std::memory_order_relaxed);
+            uint64_t new_head = ((old_head >> 32) + 1) << 32 | index;
+            if (head.compare_exchange_weak(old_head, new_head, std::memory_order_release, std::memory_order_relaxed)) {
+                free_slabs.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+        }
+    }
+
+    char* slab_data(uint32_t index) const { return slab_base + static_cast<size_t>(index) * SLAB_SIZE; }
+    IoBlock* slab_headers(uint32_t index) const { return headers + static_cast<size_t>(index) * SLAB_MAX_BLOCKS; }
+    SlabInfo& slab_info(uint32_t index) const { return infos[index]; }
+
+    uint32_t get_slab_count() const { return slab_count; }
+    uint32_t get_free_slabs() const { return free_slabs.load(std::memory_order_relaxed); }
+    ArenaPages get_pages() const { return pages; }
+    bool is_locked() const { return locked; }
+};
+
+inline BlockArena g_block_arena;
+
+// 缓冲池：每一级标准块各有一条空闲链表复用，超大块单独分配、释放时直接归还系统
+// 启用了 arena 时标准块从 arena 取 slab 切分，arena 用完才退回堆上分配
+// 只在所属的 reactor 线程内使用，不加锁；申请/归还系统内存（或 arena 的 slab）时同步更新全局账本
+class BufferPool {
+private:
+    IoBlock* free_lists[SIZE_CLASS_COUNT] = {};
+    size_t free_counts[SIZE_CLASS_COUNT] = {};
+    size_t total_blocks = 0;   // 已分配的标准块数量
+    size_t free_blocks = 0;    // 空闲链表中的块数量
+    size_t pinned_blocks = 0;  // 被引用（未归还）的块数量，含超大块
+    size_t reserved_bytes = 0; // 本池从系统申请的字节数
+    size_t in_use_bytes = 0;   // 本池正被引用的字节数
+    size_t free_bytes = 0;     // 本池空闲链表中的字节数
+
+    static void init_block(IoBlock* block, char* data, size_t capacity, uint8_t size_class, uint32_t slab) {
+        block->data = data;
+        block->next_free = nullptr;
+        block->capacity = static_cast<uint32_t>(capacity);
+        block->size = 0;
+        block->refcnt = 0;
+        block->slab = slab;
+        block->size_class = size_class;
+    }
+
+    IoBlock* allocate_block(size_t capacity, uint8_t size_class) {
+        // 块头和数据区一次分配，数据区紧跟在块头后面
+        char* raw = static_cast<char*>(::operator new(sizeof(IoBlock) + capacity));
+        IoBlock* block = reinterpret_cast<IoBlock*>(raw);
+        init_block(block, raw + sizeof(IoBlock), capacity, size_class, NO_SLAB);
+        reserved_bytes += capacity;
+        g_memory_budget.reserved.fetch_add(capacity, std::memory_order_relaxed);
+        return block;
+    }
+
+    void free_block(IoBlock* block) {
+        reserved_bytes -= block->capacity;
+        g_memory_budget.reserved.fetch_sub(block->capacity, std::memory_order_relaxed);
+        ::operator delete(block);
+    }
+
+    // 从 arena 取一个 slab 切成 size_class 级的块：第一块返回，其余放进空闲链表；arena 用完时返回 nullptr
+    IoBlock* carve_slab(uint8_t size_class) {
+        uint32_t slab = g_block_arena.acquire_slab();
+        if (slab == NO_SLAB) {
+            return nullptr;
+        }
+        size_t capacity = SIZE_CLASSES[size_class];
+        uint16_t count = static_cast<uint16_t>(SLAB_SIZE / capacity);
+        char* data = g_block_arena.slab_data(slab);
+        IoBlock* headers = g_block_arena.slab_headers(slab);
+        g_block_arena.slab_info(slab) = SlabInfo{count, 0, false};
+        for (uint16_t i = 0; i < count; ++i) {
+            init_block(&headers[i], data + i * capacity, capacity, size_class, slab);
+        }
+        for (uint16_t i = count; i-- > 1;) {
+            push_free(&headers[i]);
+        }
+        total_blocks += count;
+        reserved_bytes += SLAB_SIZE;
+        g_memory_budget.reserved.fetch_add(SLAB_SIZE, std::memory_order_relaxed);
+        return &headers[0];
+    }
+
+    void push_free(IoBlock* block) {
+        block->next_free = free_lists[block->size_class];
+        free_lists[block->size_class] = block;
+        ++free_counts[block->size_class];
+        ++free_blocks;
+        free_bytes += block->capacity;
+        if (block->slab != NO_SLAB) {
+            ++g_block_arena.slab_info(block->slab).free_count;
+        }
+    }
+
+    IoBlock* pop_free(uint8_t size_class) {
+        IoBlock* block = free_lists[size_class];
+        if (block != nullptr) {
+            free_lists[size_class] = block->next_free;
+            --free_counts[size_class];
+            --free_blocks;
+            free_bytes -= block->capacity;
+            if (block->slab != NO_SLAB) {
+                --g_block_arena.slab_info(block->slab).free_count;
+            }
+        }
+        return block;
+    }
+
+    // trim 摘下一个空闲块：堆上的块直接释放，arena 的块在整个 slab 都摘完时把 slab 还给 arena
+    size_t discard_free(IoBlock* block) {
+        --free_counts[block->size_class];
+        --free_blocks;
+        free_bytes -= block->capacity;
+        --total_blocks;
+        if (block->slab == NO_SLAB) {
+            size_t capacity = block->capacity;
+            free_block(block);
+            return capacity;
+        }
+        SlabInfo& info = g_block_arena.slab_info(block->slab);
+        if (--info.free_count != 0) {
+            return 0;
+        }
+        g_block_arena.release_slab(block->slab);
+        reserved_bytes -= SLAB_SIZE;
+        g_memory_budget.reserved.fetch_sub(SLAB_SIZE, std::memory_order_relaxed);
+        return SLAB_SIZE;
+    }
+
+    IoBlock* take(IoBlock* block) {
+        block->size = 0;
+        block->refcnt = 1;
+        block->next_free = nullptr;
+        ++pinned_blocks;
+        in_use_bytes += block->capacity;
+        g_memory_budget.in_use.fetch_add(block->capacity, std::memory_order_relaxed);
+        return block;
+    }
+
+public:
+    BufferPool() = default;
+    BufferPool(const BufferPool&) = delete;
+    BufferPool& operator=(const BufferPool&) = delete;
+
+    ~BufferPool() { trim(0); }
+
+    // 取出一个至少能容纳 min_capacity 字节的块，引用计数为 1；总能成功（不受预算限制）
+    IoBlock* acquire(size_t min_capacity = IO_BLOCK_SIZE) {
+        uint8_t size_class = size_class_for(min_capacity);
+        if (size_class == OVERSIZE_CLASS) {
+            return take(allocate_block(min_capacity, OVERSIZE_CLASS));
+        }
+        IoBlock* block = pop_free(size_class);
+        if (block == nullptr && g_block_arena.enabled()) {
+            block = carve_slab(size_class);
+        }
+        if (block == nullptr) {
+            block = allocate_block(SIZE_CLASSES[size_class], size_class);
+            ++total_blocks;
+        }
+        return take(block);
+    }
+
+    // 同 acquire，但超出全局预算时不再向系统（或 arena）申请新内存，返回 nullptr（空闲链表里有块时照常复用）
+    IoBlock* try_acquire(size_t min_capacity) {
+        uint8_t size_class = size_class_for(min_capacity);
+        if (g_memory_budget.exceeded() && (size_class == OVERSIZE_CLASS || free_lists[size_class] == nullptr)) {
+            return nullptr;
+        }
+        return acquire(min_capacity);
+    }
+
+    void retain(IoBlock* block) { ++block->refcnt; }
+
+    // 引用计数减一，归零时标准块回到对应分级的空闲链表，超大块直接释放
+    void release(IoBlock* block) {
+        if (--block->refcnt != 0) {
+            return;
+        }
+        --pinned_blocks;
+        in_use_bytes -= block->capacity;
+        g_memory_budget.in_use.fetch_sub(block->capacity, std::memory_order_relaxed);
+        if (block->size_class == OVERSIZE_CLASS) {
+            free_block(block);
+            return;
+        }
+        push_free(block);
+    }
+
+    // 把空闲链表缩减到最多 keep_bytes 字节，多余的块还给系统（先还大块），返回释放的字节数
+    // arena 的块只能整个 slab 归还：只摘所有块都空闲的 slab，摘了就摘完（可能略低于 keep_bytes）
+    size_t trim(size_t keep_bytes) {
+        size_t released = 0;
+        for (int i = SIZE_CLASS_COUNT - 1; i >= 0 && free_bytes > keep_bytes; --i) {
+            IoBlock** link = &free_lists[i];
+            while (*link != nullptr) {
+                IoBlock* block = *link;
+                bool discard;
+                if (block->slab == NO_SLAB) {
+                    discard = free_bytes > keep_bytes;
+                } else {
+                    SlabInfo& info = g_block_arena.slab_info(block->slab);
+                    if (!info.releasing && info.free_count == info.block_count && free_bytes > keep_bytes) {
+                        info.releasing = true;  // slab 的第一块：决定整个 slab 是否归还
+                    }
+                    discard = info.releasing;
+                }
+                if (discard) {
+                    *link = block->next_free;
+                    released += discard_free(block);
+                } else {
+                    link = &block->next_free;
+                }
+            }
+        }
+        return released;
+    }
+
+    size_t get_total_blocks() const { return total_blocks; }
+    size_t get_free_blocks() const { return free_blocks; }
+    size_t get_pinned_blocks() const { return pinned_blocks; }
+    size_t get_reserved_bytes() const { return reserved_bytes; }
+    size_t get_in_use_bytes() const { return in_use_bytes; }
+    size_t get_free_bytes() const { return free_bytes; }
+    size_t get_free_count(uint8_t size_class) const { return free_counts[size_class]; }
+};
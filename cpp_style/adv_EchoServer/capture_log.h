@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <ctime>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// 流量抓取日志：服务器按连接记录建立、读、写、关闭事件，replay 工具读出来重放
+// 文件格式：一个 CaptureHeader，后面紧跟一串 CaptureRecord，每条记录后面跟 payload_len 字节的数据（补齐到 8 字节）
+// 记录按追加顺序存放，多个 reactor 并发追加时时间戳可能略有交错，读取方按时间排序
+// type 为 0 的记录表示日志结束（文件预先扩展到最大容量，未写到的部分全是 0）
+
+constexpr char CAPTURE_MAGIC[8] = {'E', 'C', 'H', 'O', 'C', 'A', 'P', '1'};
+constexpr uint32_t CAPTURE_VERSION = 1;
+
+struct CaptureHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;       // 第一条记录的偏移
+    uint32_t max_payload;       // 每条读事件最多保存的数据字节数，0 表示只记长度
+    uint32_t reserved;
+    uint64_t start_realtime_ns; // 开始抓取时的墙上时间，记录里的时间戳是相对开始时刻的单调时钟
+};
+
+enum class CaptureEvent : uint8_t {
+    End = 0,    // 日志结束
+    Open = 1,   // 连接建立
+    Read = 2,   // 服务器从客户端读到数据（客户端 → 服务器）
+    Write = 3,  // 服务器向客户端写出数据（服务器 → 客户端），只记长度
+    Close = 4,  // 连接关闭
+};
+
+struct CaptureRecord {
+    uint64_t time_ns;      // 相对开始抓取时刻的时间
+    uint32_t conn_id;      // 抓取内的连接编号，从 1 开始
+    uint32_t length;       // 这次读/写的字节数
+    uint32_t payload_len;  // 记录后面保存的数据字节数（length 超过 max_payload 时截断）
+    uint8_t type;          // CaptureEvent，最后写入，读取方看到非 0 才说明记录已写完
+    uint8_t padding[3];
+};
+
+inline size_t capture_record_size(uint32_t payload_len) {
+    return sizeof(CaptureRecord) + ((payload_len + 7) & ~size_t{7});
+}
+
+inline uint64_t capture_clock_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// 抓取日志的写入端：整个文件按最大容量映射进内存，追加一条记录只是一次原子加法 + 内存拷贝，没有系统调用
+// 各 reactor 线程并发追加；写满后丢弃新记录并计数（数据由内核回写，进程被杀掉也不会丢已写入的记录）
+class CaptureLog {
+private:
+    char* base = nullptr;
+    size_t capacity = 0;
+    uint32_t max_payload = 0;
+    uint64_t start_ns = 0;
+    std::atomic<size_t> tail{0};
+    std::atomic<uint64_t> records{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint32_t> next_conn{1};
+
+public:
+    CaptureLog() = default;
+    CaptureLog(const CaptureLog&) = delete;
+    CaptureLog& operator=(const CaptureLog&) = delete;
+
+    ~CaptureLog() {
+        if (base != nullptr) {
+            munmap(base, capacity);
+        }
+    }
+
+    // 创建（截断）日志文件并映射 max_bytes 字节，必须在服务器开始接受连接之前调用
+    void open(const std::string& path, size_t max_bytes, uint32_t payload_limit) {
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "创建抓取日志失败：" + path);
+        }
+        // 文件先扩展成稀疏文件，只有写到的页才占磁盘
+        if (ftruncate(fd, static_cast<off_t>(max_bytes)) == -1) {
+            int err = errno;
+            close(fd);
+            throw std::system_error(err, std::generic_category(), "扩展抓取日志失败");
+        }
+        void* addr = mmap(nullptr, max_bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        int err = errno;
+        close(fd);  // 映射建立后文件描述符就不需要了
+        if (addr == MAP_FAILED) {
+            throw std::system_error(err, std::generic_category(), "映射抓取日志失败");
+        }
+        base = static_cast<char*>(addr);
+        capacity = max_bytes;
+        max_payload = payload_limit;
+        start_ns = capture_clock_ns();
+
+        struct timespec now;
+        clock_gettime(CLOCK_REALTIME, &now);
+        CaptureHeader header{};
+        memcpy(header.magic, CAPTURE_MAGIC, sizeof(header.magic));
+        header.version = CAPTURE_VERSION;
+        header.header_size = sizeof(CaptureHeader);
+        header.max_payload = max_payload;
+        header.start_realtime_ns = static_cast<uint64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+        memcpy(base, &header, sizeof(header));
+        tail.store(sizeof(CaptureHeader), std::memory_order_relaxed);
+    }
+
+    bool enabled() const { return base != nullptr; }
+
+    // 分配一个新的连接编号
+    uint32_t new_connection() { return next_conn.fetch_add(1, std::memory_order_relaxed); }
+
+    // 追加一条记录；data 只在读事件且开启了 payload 时保存
+    void append(uint32_t conn_id, CaptureEvent type, const char* data = nullptr, size_t length = 0) {
+        uint32_t payload_len = 0;
+        if (type == CaptureEvent::Read && data != nullptr) {
+            payload_len = static_cast<uint32_t>(std::min<size_t>(length, max_payload));
+        }
+        size_t size = capture_record_size(payload_len);
+        size_t offset = tail.fetch_add(size, std::memory_order_relaxed);
+        // 留出一条空记录的位置，读取方总能读到结束标记
+        if (offset + size + sizeof(CaptureRecord) > capacity) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        auto* record = reinterpret_cast<CaptureRecord*>(base + offset);
+        record->time_ns = capture_clock_ns() - start_ns;
+        record->conn_id = conn_id;
+        record->length = static_cast<uint32_t>(length);
+        record->payload_len = payload_len;
+        if (payload_len != 0) {
+            memcpy(record + 1, data, payload_len);
+        }
+        std::atomic_ref<uint8_t>(record->type).store(static_cast<uint8_t>(type), std::memory_order_release);
+        records.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    size_t get_used_bytes() const { return std::min(tail.load(std::memory_order_relaxed), capacity); }
+    size_t get_capacity() const { return capacity; }
+    uint64_t get_records() const { return records.load(std::memory_order_relaxed); }
+    uint64_t get_dropped() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+inline CaptureLog g_capture_log;
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// 延迟直方图（单位纳秒）：每个 2 的幂次区间再线性分成 8 个子桶，相对误差约 12%
+// 记录是 O(1) 的数组自增，不分配内存，适合放在事件循环的热路径上
+class LatencyHistogram {
+private:
+    static constexpr int SUB_BITS = 3;
+    static constexpr uint64_t SUB_COUNT = 1 << SUB_BITS;
+    static constexpr int MAX_BITS = 42;  // 2^42 ns ≈ 73 分钟，更大的值计入最后一个桶
+    static constexpr int BUCKET_COUNT = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+    uint64_t buckets[BUCKET_COUNT] = {};
+    uint64_t total = 0;
+    uint64_t sum = 0;
+    uint64_t max_value = 0;
+
+    static int bucket_index(uint64_t value) {
+        if (value < SUB_COUNT) {
+            return static_cast<int>(value);
+        }
+        int msb = 63 - __builtin_clzll(value);
+        if (msb >= MAX_BITS) {
+            return BUCKET_COUNT - 1;
+        }
+        int shift = msb - SUB_BITS;
+        return (msb - SUB_BITS + 1) * SUB_COUNT + static_cast<int>((value >> shift) & (SUB_COUNT - 1));
+    }
+
+    // 桶的上界（不含），分位数按上界报告，偏保守
+    static uint64_t bucket_upper(int index) {
+        if (index < static_cast<int>(SUB_COUNT)) {
+            return index + 1;
+        }
+        int shift = index / SUB_COUNT - 1;
+        uint64_t sub = index % SUB_COUNT;
+        return ((SUB_COUNT + sub + 1) << shift);
+    }
+
+public:
+    void record(int64_t ns) {
+        uint64_t value = ns > 0 ? static_cast<uint64_t>(ns) : 0;
+        ++buckets[bucket_index(value)];
+        ++total;
+        sum += value;
+        max_value = std::max(max_value, value);
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t mean() const { return total == 0 ? 0 : sum / total; }
+    uint64_t max() const { return max_value; }
+
+    // 第 p（0~1）分位数所在桶的上界
+    uint64_t percentile(double p) const {
+        if (total == 0) {
+            return 0;
+        }
+        uint64_t rank = static_cast<uint64_t>(p * (total - 1)) + 1;
+        uint64_t seen = 0;
+        for (int i = 0; i < BUCKET_COUNT; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                return std::min(bucket_upper(i), max_value);
+            }
+        }
+        return max_value;
+    }
+};
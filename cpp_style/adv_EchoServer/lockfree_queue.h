@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+constexpr size_t CACHE_LINE_SIZE = 64;  // 生产者/消费者各自的下标分开放在不同缓存行，避免伪共享
+
+// 单生产者单消费者的有界环形队列（无锁）
+// 容量向上取整为 2 的幂，下标用掩码取模；只存放可平凡拷贝的小对象（比如指针、fd）
+template <typename T>
+class SpscQueue {
+private:
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> head{0};  // 消费者读取位置
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> tail{0};  // 生产者写入位置
+    alignas(CACHE_LINE_SIZE) size_t mask;
+    std::unique_ptr<T[]> slots;
+
+public:
+    explicit SpscQueue(size_t capacity) {
+        size_t size = 1;
+        while (size < capacity) {
+            size <<= 1;
+        }
+        mask = size - 1;
+        slots = std::make_unique<T[]>(size);
+    }
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // 生产者调用，队列满时返回 false
+    bool push(const T& value) {
+        size_t t = tail.load(std::memory_order_relaxed);
+        if (t - head.load(std::memory_order_acquire) > mask) {
+            return false;
+        }
+        slots[t & mask] = value;
+        tail.store(t + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 消费者调用，队列空时返回 false
+    bool pop(T& value) {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = slots[h & mask];
+        head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool empty() const { return head.load(std::memory_order_acquire) == tail.load(std::memory_order_acquire); }
+    size_t size() const { return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire); }
+};
+
+// 多生产者单消费者的侵入式队列（无锁，无界）
+// 生产者用 CAS 把节点压到链表头；消费者一次取走整条链表并反转，得到按入队顺序排列的节点
+// 同一个生产者入队的节点保持先后顺序；节点类型需要有 T* next 成员
+template <typename T>
+class MpscQueue {
+private:
+    alignas(CACHE_LINE_SIZE) std::atomic<T*> head{nullptr};
+
+public:
+    void push(T* node) {
+        node->next = head.load(std::memory_order_relaxed);
+        while (!head.compare_exchange_weak(node->next, node, std::memory_order_release,
+                                           std::memory_order_relaxed)) {
+        }
+    }
+
+    // 取走当前所有节点，返回按入队顺序链接的链表头（队列为空时返回 nullptr）
+    T* pop_all() {
+        T* node = head.exchange(nullptr, std::memory_order_acquire);
+        T* reversed = nullptr;
+        while (node != nullptr) {
+            T* next = node->next;
+            node->next = reversed;
+            reversed = node;
+            node = next;
+        }
+        return reversed;
+    }
+};
@@ -0,0 +1,145 @@
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <vector>
+
+// 令牌桶：按固定速率补充令牌，最多攒 burst 个
+// 令牌以"微令牌"（× 1e6）计数，按微秒补充，低速率下每次补充的零头也不会丢
+// rate 为 0 表示不限速
+struct TokenBucket {
+    static constexpr int64_t SCALE = 1000000;
+
+    int64_t tokens = 0;    // 当前微令牌数（可以为负：消息数只能读完才知道，允许先欠着）
+    int64_t rate = 0;      // 每秒补充的令牌数
+    int64_t burst = 0;     // 桶容量（令牌数）
+    uint64_t last_us = 0;  // 上次补充的时间
+
+    void init(int64_t rate_per_sec, int64_t burst_tokens, uint64_t now_us) {
+        rate = rate_per_sec;
+        burst = burst_tokens;
+        tokens = burst_tokens * SCALE;
+        last_us = now_us;
+    }
+
+    void refill(uint64_t now_us) {
+        if (rate == 0 || now_us <= last_us) {
+            return;
+        }
+        // 先把间隔截到补满所需的时长，长时间空闲后 rate * 间隔 不会溢出
+        uint64_t fill_us = static_cast<uint64_t>((burst * SCALE - std::min(tokens, burst * SCALE)) / rate + 1);
+        int64_t elapsed_us = static_cast<int64_t>(std::min(now_us - last_us, fill_us));
+        tokens = std::min(burst * SCALE, tokens + rate * elapsed_us);
+        last_us = now_us;
+    }
+
+    // 当前可用的整令牌数，不限速时返回 INT64_MAX
+    int64_t available() const { return rate == 0 ? INT64_MAX : tokens / SCALE; }
+
+    void consume(int64_t count) {
+        if (rate != 0) {
+            tokens -= count * SCALE;
+        }
+    }
+
+    bool full() const { return rate == 0 || tokens >= burst * SCALE; }
+};
+
+// 按源 IP 限速的状态
+struct IpRateState {
+    uint32_t connections = 0;  // 该 IP 当前的连接数
+    TokenBucket bytes;         // 字节数令牌桶
+    TokenBucket messages;      // 消息数（行数）令牌桶
+};
+
+// 源 IP → 限速状态的哈希表：开放寻址 + 线性探测，键是网络字节序的 IPv4 地址
+// 槽位连续存放，没有逐项的堆分配；返回的指针在下一次 insert/retain_if 之前有效
+// 只在所属的 reactor 线程内使用，不加锁
+class IpRateTable {
+private:
+    struct Slot {
+        uint32_t addr;
+        bool used;
+        IpRateState state;
+    };
+
+    static constexpr size_t MIN_CAPACITY = 64;
+
+    std::vector<Slot> slots;
+    size_t count = 0;
+    uint32_t shift = 32;  // 32 - log2(槽位数)
+
+    size_t home(uint32_t addr) const {
+        // 乘法哈希取高位，连续网段的地址也能分散开
+        return static_cast<uint32_t>(addr * 2654435761u) >> shift;
+    }
+
+    void rebuild(size_t capacity) {
+        std::vector<Slot> old = std::move(slots);
+        slots.assign(capacity, Slot{0, false, {}});
+        shift = 32 - __builtin_ctzll(capacity);
+        count = 0;
+        for (Slot& slot : old) {
+            if (slot.used) {
+                insert_slot(slot.addr).state = slot.state;
+            }
+        }
+    }
+
+    Slot& insert_slot(uint32_t addr) {
+        size_t mask = slots.size() - 1;
+        size_t i = home(addr);
+        while (slots[i].used && slots[i].addr != addr) {
+            i = (i + 1) & mask;
+        }
+        if (!slots[i].used) {
+            slots[i].used = true;
+            slots[i].addr = addr;
+            slots[i].state = IpRateState{};
+            ++count;
+        }
+        return slots[i];
+    }
+
+public:
+    IpRateTable() { rebuild(MIN_CAPACITY); }
+
+    IpRateState* find(uint32_t addr) {
+        size_t mask = slots.size() - 1;
+        for (size_t i = home(addr); slots[i].used; i = (i + 1) & mask) {
+            if (slots[i].addr == addr) {
+                return &slots[i].state;
+            }
+        }
+        return nullptr;
+    }
+
+    // 查找或插入，新插入的状态由调用方初始化（new_entry 为 true）；负载因子超过 0.7 时扩容
+    IpRateState& insert(uint32_t addr, bool& new_entry) {
+        if ((count + 1) * 10 > slots.size() * 7) {
+            rebuild(slots.size() * 2);
+        }
+        size_t before = count;
+        Slot& slot = insert_slot(addr);
+        new_entry = count != before;
+        return slot.state;
+    }
+
+    // 只保留满足条件的条目，重新按大小紧凑排列（删除后无需墓碑标记）
+    template <typename Pred>
+    void retain_if(Pred pred) {
+        size_t kept = 0;
+        for (Slot& slot : slots) {
+            if (slot.used && pred(slot.state)) {
+                ++kept;
+            } else {
+                slot.used = false;
+            }
+        }
+        rebuild(std::bit_ceil(std::max(kept * 2, MIN_CAPACITY)));
+    }
+
+    size_t size() const { return count; }
+    size_t capacity() const { return slots.size(); }
+};
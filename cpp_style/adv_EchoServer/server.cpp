@@ -11,19 +11,355 @@
 #include <arpa/inet.h>
 #include <sys/epoll.h>
 #include <fcntl.h>  //设置非阻塞 IO
+#include <deque>
+#include <array>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <string_view>
+#include <csignal>
+#include <sys/signalfd.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <ctime>
+#include <netinet/tcp.h>
+#include <sys/un.h>
+#include <linux/errqueue.h>  // MSG_ZEROCOPY 完成通知（sock_extended_err）、发送时间戳（scm_timestamping）
+#include <linux/net_tstamp.h>  // SO_TIMESTAMPING 标志
+
+#include "buffer_pool.h"
+#include "worker_pool.h"
+#include "socket_options.h"
+#include "rate_limiter.h"
+#include "latency_histogram.h"
+#include "usdt.h"
+#include "capture_log.h"
+#include "shm_ring.h"
+
+// 数据路径上的系统调用入口，默认就是系统调用本身
+// bench/handler_bench.cpp 在包含本文件前把它们换成计数/模拟版本，在进程内直接驱动事件处理函数
+#ifndef ECHO_SYS_READ
+#define ECHO_SYS_READ ::read
+#endif
+#ifndef ECHO_SYS_SEND
+#define ECHO_SYS_SEND ::send
+#endif
+#ifndef ECHO_SYS_EPOLL_CTL
+#define ECHO_SYS_EPOLL_CTL ::epoll_ctl
+#endif
 
 constexpr int PORT = 8080;
-constexpr int BUFFER_SIZE = 4096;
+constexpr int BUFFER_SIZE = 4096;  // 新连接的初始读缓冲大小（之后按实际流量在各级块之间调整）
 constexpr int MAX_EVENTS = 1024;  //epoll 最大监听事件数
 constexpr int EPOLL_TIMEOUT = -1; // epoll_wait 阻塞时间（-1 表示无限阻塞，直到有事件）
+// 零拷贝发送阈值：小于该值的回复走普通拷贝路径
+// 内核文档给出的经验值是 10KB 左右才划算，实际值请用压测数据通过 --zerocopy-threshold 调整
+constexpr size_t ZEROCOPY_THRESHOLD = 16 * 1024;
+constexpr uint64_t ZEROCOPY_DRAIN_TIMEOUT_MS = 10000;  // 关闭时等零拷贝完成通知的最长时间，超时的块隔离起来不再使用
+// 背压水位：对端待发送数据超过高水位时暂停读，降到低水位以下再恢复
+constexpr size_t HIGH_WATERMARK = 1024 * 1024;
+constexpr size_t LOW_WATERMARK = 256 * 1024;
+constexpr size_t BACKEND_POOL_SIZE = 16;  // 代理模式下每个 reactor 预先建好的后端连接数
+constexpr uint64_t BACKEND_POOL_REFILL_MS = 1000;  // 定时补充后端连接池的周期（后端不可用时也限制了重连频率）
+constexpr int BACKEND_KEEPALIVE_IDLE = 60;  // 后端连接 TCP keepalive 空闲探测时间（秒）
+constexpr size_t ROOM_MAX_LAG = 4 * 1024 * 1024;  // 房间模式下订阅者允许积压的最大字节数
+constexpr size_t OFFLOAD_QUEUE_CAPACITY = 4096;   // offload 模式下每个 worker 的请求队列容量
+constexpr size_t OFFLOAD_MAX_INFLIGHT = 1024;     // offload 模式下单个连接允许的在途请求数，超过后暂停读
+constexpr size_t REACTOR_INBOX_CAPACITY = 4096;   // 主/从 reactor 模式下每个从 reactor 的新连接队列容量
+constexpr int TICK_INTERVAL_MS = 100;             // reactor 定时器周期（空闲回收、内存预算检查）
+constexpr uint64_t IDLE_RECLAIM_MS = 5000;        // 连接空闲超过该时间后把缓冲块换成刚好够用的小块
+constexpr size_t POOL_KEEP_BYTES = 16 * 1024 * 1024;  // 未超预算时每个 reactor 的空闲链表最多保留的字节数
+constexpr uint8_t READ_SHRINK_EVENTS = 8;         // 连续多少次读事件都用不满下一级块时，读缓冲降一级
+constexpr uint64_t LAG_THRESHOLD_MS = 50;         // 事件循环延迟超过该值视为落后
+constexpr uint32_t OVERLOAD_ENTER_TICKS = 3;      // 连续多少个定时器周期落后才进入过载（过滤偶发抖动）
+constexpr uint32_t OVERLOAD_EXIT_TICKS = 10;      // 进入过载后，连续多少个周期延迟低于阈值一半才恢复
+constexpr uint64_t IP_SWEEP_INTERVAL_MS = 1000;   // 清理按 IP 限速表中不再需要的条目的周期
+constexpr size_t CAPTURE_SIZE = 256 * 1024 * 1024;  // 抓取日志默认的最大字节数
+constexpr size_t CAPTURE_PAYLOAD = 64 * 1024;      // --capture-payload 不带参数时每次读保存的最大数据字节数
+constexpr size_t TIMESTAMP_SAMPLE = 64;           // --timestamping 不带参数时的采样间隔（每多少次读事件采样一次）
+constexpr size_t SHM_EVENT_BUDGET = 256 * 1024;   // 共享内存会话每次事件最多搬运的字节数，超过后让给其他连接
+
+// 服务器运行模式
+enum class ServerMode {
+    Echo,   // 回声：数据原样发回给客户端
+    Proxy,  // 代理：数据转发给后端，后端的回复再转发给客户端
+    Room,   // 房间：按行切分消息，每条消息广播给房间内的其他所有客户端
+    Offload,  // 计算卸载：按行切分请求，交给 worker 线程池处理，结果按请求顺序回复
+};
+
+// 房间模式下对慢订阅者（积压超过 room_max_lag）的处理策略
+enum class SlowPolicy {
+    Drop,  // 断开慢订阅者
+    Lag,   // 跳过投递，订阅者丢失这部分消息但保持连接
+};
+
+// 超出全局内存预算时的处理策略（无论哪种策略，拿不到新块的连接都会暂停读）
+enum class MemoryPolicy {
+    Pause,  // 只暂停读，等其他连接把数据发走、内存降下来再恢复
+    Shed,   // 另外由定时器断开本 reactor 上占用内存最多的连接，直到回到预算以内
+};
+
+// 事件循环持续落后（过载）时的准入策略
+enum class OverloadPolicy {
+    None,         // 只统计延迟，不干预
+    PauseAccept,  // 暂停 accept，新连接留在内核 backlog 里，恢复后再接收
+    Reject,       // 照常 accept 但立即用 RST 拒绝，让客户端尽快失败重试而不是干等
+    Shed,         // 拒绝新连接，并且每个定时器周期断开一个积压最多的连接
+};
+
+// 主/从 reactor 模式下 acceptor 选择从 reactor 的策略
+enum class DispatchPolicy {
+    RoundRobin,  // 轮询
+    LeastLoad,   // 当前连接数最少的优先
+};
+
+// 服务器配置（由命令行参数覆盖默认值）
+struct ServerConfig {
+    uint16_t port = PORT;                             // 监听端口
+    int listen_fd = -1;                               // 继承的监听 socket（>= 0 时不再自己创建）
+    size_t reactors = 0;                              // 从 reactor 线程数，0 表示单 reactor
+    DispatchPolicy dispatch = DispatchPolicy::RoundRobin;  // 新连接分发策略
+    ServerMode mode = ServerMode::Echo;               // 运行模式
+    struct sockaddr_in backend_addr{};                // 代理模式的后端地址
+    size_t backend_pool_size = BACKEND_POOL_SIZE;     // 预连接的后端连接池容量（0 表示不预连接）
+    SlowPolicy slow_policy = SlowPolicy::Drop;        // 房间模式的慢订阅者策略
+    size_t room_max_lag = ROOM_MAX_LAG;               // 房间模式下订阅者允许积压的字节数
+    bool verbose = true;                              // 是否逐条打印收发的数据（压测时用 --quiet 关闭）
+    size_t workers = std::max(1u, std::thread::hardware_concurrency());  // offload 模式的 worker 线程数
+    SocketProfile socket_profile = make_socket_profile("none");         // 监听 socket 及其连接的调优参数
+    bool zerocopy = false;                            // 是否对大回复启用 MSG_ZEROCOPY
+    size_t zerocopy_threshold = ZEROCOPY_THRESHOLD;   // 启用零拷贝的最小回复长度
+    size_t memory_budget = 0;                         // 所有 reactor 的缓冲块总字节数上限，0 表示不限
+    MemoryPolicy memory_policy = MemoryPolicy::Pause; // 超出内存预算时的处理策略
+    size_t arena_bytes = 0;                           // 启动时预留的缓冲块 arena 大小，0 表示不用 arena（块从堆上分配）
+    ArenaPages arena_pages = ArenaPages::Auto;        // arena 的页类型
+    bool arena_mlock = false;                         // 是否 mlock 锁住 arena
+    uint64_t lag_threshold_us = LAG_THRESHOLD_MS * 1000;  // 判定事件循环落后的延迟阈值
+    OverloadPolicy overload_policy = OverloadPolicy::None;  // 过载时的准入策略
+    // 限速（0 表示不限）：桶容量为 1 秒的量，即允许 1 秒内的突发
+    int64_t rate_bytes = 0;                           // 每个连接每秒可读的字节数
+    int64_t rate_messages = 0;                        // 每个连接每秒可发的消息数（按行计）
+    int64_t ip_rate_bytes = 0;                        // 每个源 IP 每秒可读的字节数（同一 reactor 内的所有连接合计）
+    int64_t ip_rate_messages = 0;                     // 每个源 IP 每秒可发的消息数
+
+    size_t timestamp_sample = 0;                      // 时间戳追踪的采样间隔（读事件数），0 表示关闭
+    std::string capture_path;                         // 抓取日志的路径，空表示不抓取
+    size_t capture_size = CAPTURE_SIZE;               // 抓取日志的最大字节数，写满后丢弃新事件
+    size_t capture_payload = 0;                       // 每次读保存的最大数据字节数，0 表示只记长度
+    std::string unix_path;                            // 额外监听的 Unix 域 socket 路径，空表示不监听
+    std::string shm_path;                             // 共享内存传输的握手 socket 路径，空表示不开启
+
+    bool ip_rate_limited() const { return ip_rate_bytes != 0 || ip_rate_messages != 0; }
+    bool rate_limited() const { return rate_bytes != 0 || rate_messages != 0 || ip_rate_limited(); }
+};
+
+// 服务器统计信息（收到 SIGUSR1 时打印）
+struct ServerStats {
+    uint64_t accepted = 0;         // 累计接受的连接数
+    uint64_t closed = 0;           // 累计关闭的连接数
+    uint64_t bytes_read = 0;       // 累计读取字节数
+    uint64_t bytes_written = 0;    // 累计发送字节数
+    uint64_t zc_sends = 0;         // MSG_ZEROCOPY 发送次数
+    uint64_t zc_bytes = 0;         // MSG_ZEROCOPY 发送字节数
+    uint64_t zc_completions = 0;   // 内核通知完成的零拷贝发送次数
+    uint64_t zc_copied = 0;        // 内核退化为拷贝的零拷贝发送次数
+    uint64_t zc_fallbacks = 0;     // 因 ENOBUFS 改走拷贝路径的次数
+    uint64_t zc_drains = 0;        // 关闭时还有零拷贝发送未完成、先等完成通知的连接数
+    uint64_t zc_quarantined = 0;   // 等完成通知超时、被隔离不再使用的块数
+    uint64_t read_pauses = 0;      // 因背压暂停读的次数
+    uint64_t upstream_connects = 0;  // 新建的后端连接数
+    uint64_t upstream_pooled = 0;    // 从预连接池取出的后端连接数
+    uint64_t room_messages = 0;      // 房间模式发布的消息数
+    uint64_t room_deliveries = 0;    // 房间模式投递到订阅者队列的次数
+    uint64_t room_lagged = 0;        // 因订阅者积压而跳过的投递次数
+    uint64_t room_dropped = 0;       // 因积压被断开的订阅者数
+    uint64_t offload_submitted = 0;  // offload 模式提交的请求数
+    uint64_t offload_completed = 0;  // worker 处理完送回的请求数
+    uint64_t offload_inline = 0;     // worker 队列全满、在 reactor 上直接处理的请求数
+    uint64_t dispatched = 0;         // acceptor 分发给从 reactor 的连接数
+    uint64_t rejected = 0;           // 从 reactor 队列全满被拒绝的连接数
+    uint64_t memory_pauses = 0;      // 因超出内存预算暂停读的次数
+    uint64_t memory_sheds = 0;       // 因超出内存预算被断开的连接数
+    uint64_t reclaimed_bytes = 0;    // 空闲连接换小块腾出的字节数
+    uint64_t trimmed_bytes = 0;      // 空闲链表归还给系统的字节数
+    uint64_t overload_entered = 0;   // 进入过载状态的次数
+    uint64_t overload_rejected = 0;  // 过载期间用 RST 拒绝的新连接数
+    uint64_t overload_shed = 0;      // 过载期间断开的已有连接数
+    uint64_t accept_pauses = 0;      // 过载期间暂停 accept 的次数
+    uint64_t rate_throttles = 0;     // 令牌不足暂停读的次数
+    uint64_t shm_sessions = 0;       // 建立的共享内存会话数
+    uint64_t shm_bytes = 0;          // 共享内存会话回声的字节数
+    uint64_t shm_wakeups = 0;        // 共享内存会话的 eventfd 事件次数（客户端叫醒服务器）
+    uint64_t shm_signals = 0;        // 写客户端 eventfd 叫醒它的次数
+};
+
+// 时间戳追踪的各阶段耗时（每个 reactor 一份）
+// 内核软件时间戳用的是 CLOCK_REALTIME，用户态打点也用同一个时钟
+struct TraceStats {
+    uint64_t sampled = 0;            // 采样的读次数
+    uint64_t abandoned = 0;          // 没等到发送就被新采样或关闭打断的样本数
+    LatencyHistogram rx_to_read;     // 包到达协议栈 → read() 取走
+    LatencyHistogram read_to_write;  // read() → 调用 send() 发出这批数据的最后一个字节
+    LatencyHistogram write_to_tx;    // send() → 交给网卡驱动（发送软件时间戳）
+};
+
+// 连接作为数据去向时的采样状态（只有回声、代理模式的字节能一一对应到发送流）
+enum class TraceState {
+    Idle,       // 没有在追踪的样本
+    WaitWrite,  // 采样数据在待发送队列里，等 send 越过 trace_target
+    WaitTx,     // 已 send，等错误队列里的发送时间戳
+};
+
+// 事件循环延迟的测量值和过载判定状态（每个 reactor 一份）
+// 一轮迭代的耗时就是这一轮里新就绪的事件要等的时间，批内排队延迟是最后一个事件从 epoll_wait 返回到开始处理的时间，
+// 定时器漂移是定时器实际触发时间比预期晚了多少（某个处理函数卡住整个循环时最明显）
+struct LoopMonitor {
+    uint64_t iterations = 0;       // 迭代次数
+    uint64_t busy_ewma_us = 0;     // 单轮耗时的指数移动平均（权重 1/8）
+    uint64_t busy_max_us = 0;      // 单轮耗时最大值（打印统计后清零）
+    uint64_t window_max_us = 0;    // 当前定时器周期内的单轮耗时最大值（过载判定用，每个周期清零）
+    uint64_t queue_max_us = 0;     // 批内排队延迟最大值（打印统计后清零）
+    uint64_t drift_max_us = 0;     // 定时器漂移最大值（打印统计后清零）
+    uint64_t last_tick_us = 0;     // 上次定时器触发的时间
+    uint32_t hot_ticks = 0;        // 连续落后的定时器周期数
+    uint32_t cool_ticks = 0;       // 过载后连续恢复正常的定时器周期数
+    bool overloaded = false;       // 当前是否处于过载状态
+    bool accept_paused = false;    // PauseAccept 策略下是否正在暂停 accept
+};
+
+// 配置在启动时解析完就只读；其余运行时状态每个 reactor 线程各有一份，互不共享
+ServerConfig g_config;
+thread_local ServerStats g_stats;
+thread_local BufferPool g_buffer_pool;
+thread_local LoopMonitor g_loop_monitor;
+thread_local TraceStats g_trace_stats;
+thread_local uint64_t g_trace_reads = 0;  // 读事件计数，用于按间隔采样
+thread_local uint64_t g_now_ms = 0;  // 本轮 epoll_wait 返回时的单调时钟（毫秒），事件处理中用它代替逐次取时间
+
+// 待发送数据块：块中 [offset, block->size) 区间尚未发送
+struct OutChunk {
+    IoBlock* block;
+    uint32_t offset;
+};
+
+// 已交给内核、等待完成通知的零拷贝发送（seq 与内核的计数器一一对应）
+struct ZeroCopyPending {
+    uint32_t seq;
+    IoBlock* block;
+};
+
+// 连接类型
+enum class ConnType {
+    Client,      // 客户端连接
+    Upstream,    // 代理模式下连向后端的连接
+    ShmControl,  // 共享内存传输的握手/控制连接（Unix socket）
+    ShmNotify,   // 共享内存会话里服务器的 eventfd（peer 指向控制连接）
+};
+
+struct ClientData;
+
+// 共享内存会话：握手成功后挂在控制连接上，数据不经过 out_queue，直接在两个环之间拷贝
+struct ShmSession {
+    ShmChannel channel;
+    int notify_fd = -1;                 // 客户端写它叫醒服务器（注册在 epoll 里）
+    int peer_notify_fd = -1;            // 服务器写它叫醒客户端
+    ClientData* notify_data = nullptr;  // notify_fd 在 epoll 里绑定的占位数据
+};
 
 // 客户端数据结构（复用你原有的逻辑）
+// 代理模式下后端连接也用它表示，两端通过 peer 互相指向
 struct ClientData {
     int client_fd;                // 客户端 socket FD
     std::string client_ip;        // 客户端 IP
     uint16_t client_port;         // 客户端端口
-    std::string read_buffer;      // 读取缓冲区（存储客户端数据）
-    std::string write_buffer;     // 写入缓冲区（待发送给客户端的数据）
+    ConnType type = ConnType::Client;
+    bool local = false;           // Unix 域连接：跳过 TCP 相关的 socket 选项
+    ClientData* peer = nullptr;   // 代理模式下配对的另一端（对端已断开或池中还没配对的后端连接为 nullptr）
+    std::deque<OutChunk> out_queue;           // 待发送队列（读到的数据直接放在池化的块里，按顺序回声）
+    size_t out_bytes = 0;                     // out_queue 中尚未发送的字节数
+    uint32_t armed_events = 0;                // 当前在 epoll 中注册的事件
+    bool connecting = false;                  // 非阻塞 connect 尚未完成（仅后端连接）
+    bool read_paused = false;                 // 背压：数据要写入的一端积压过多，暂停读
+    bool close_after_flush = false;           // 对端已关闭，把剩余数据发完后关闭
+    bool closed = false;                      // 已关闭，等本轮事件处理完再释放
+    bool memory_paused = false;               // 超出内存预算拿不到新块，暂停读（由定时器恢复）
+    bool rate_paused = false;                 // 限速令牌用完，暂停读（由定时器在令牌补足后恢复）
+    uint32_t client_addr = 0;                 // 客户端 IPv4 地址（网络字节序），按 IP 限速的键
+    TokenBucket byte_bucket;                  // 连接级字节数令牌桶
+    TokenBucket message_bucket;               // 连接级消息数令牌桶
+    bool timestamping = false;                // 该连接是否开启了 SO_TIMESTAMPING
+    TraceState trace_state = TraceState::Idle;  // 时间戳追踪：该连接作为数据去向时的采样状态
+    uint64_t trace_target = 0;                // 采样数据末尾在本连接发送字节流中的位置
+    int64_t trace_read_ns = 0;                // 采样数据被 read 的时间
+    int64_t trace_write_ns = 0;               // 采样数据最后一个字节被 send 的时间
+    uint64_t bytes_sent = 0;                  // 累计发送字节数（与 SOF_TIMESTAMPING_OPT_ID 的字节序号对应）
+    uint32_t capture_id = 0;                  // 抓取日志里的连接编号，0 表示不抓取（后端连接、未开启抓取）
+    uint8_t read_class = size_class_for(BUFFER_SIZE);  // 读缓冲的块分级，按每次读事件的数据量调整
+    uint8_t small_reads = 0;                  // 连续用不满下一级块的读事件数
+    uint64_t last_active_ms = 0;              // 最近一次读写的时间，用于空闲回收
+    size_t conn_index = 0;                    // 在 g_connections 中的下标
+    IoBlock* partial_message = nullptr;       // 按行处理的模式：尚未读到换行符的半条消息
+    uint64_t offload_next_seq = 0;            // offload 模式：下一个请求的序号
+    uint64_t offload_deliver_seq = 0;         // offload 模式：下一个该回复的请求序号
+    std::deque<OffloadTask*> offload_reorder; // offload 模式：重排窗口，下标 i 对应序号 deliver_seq + i，未完成为 nullptr
+    uint32_t offload_inflight = 0;            // offload 模式：已交给 worker 还没送回的请求数
+    bool offload_detached = false;            // 已关闭但还有在途请求，由最后一个送回的结果负责释放
+    bool zerocopy = false;                    // 该连接是否启用 MSG_ZEROCOPY
+    uint32_t zc_next_seq = 0;                 // 下一次零拷贝发送的序号
+    std::deque<ZeroCopyPending> zc_pending;   // 等待内核释放的块（持有引用，防止被复用）
+    bool zc_draining = false;                 // 已关闭，fd 保留到零拷贝发送全部完成（或超时）
+    uint64_t zc_drain_deadline_ms = 0;        // 等完成通知的截止时间
+    std::unique_ptr<ShmSession> shm;          // 共享内存控制连接：握手成功后的会话
+};
+
+thread_local std::vector<ClientData*> g_idle_upstreams;  // 预先建好、从未配对过客户端的后端连接池
+thread_local uint64_t g_pool_refill_ms = 0;              // 上次补充 g_idle_upstreams 的时间
+thread_local std::vector<ClientData*> g_zc_draining;     // 已关闭、还在等零拷贝完成通知的连接
+thread_local std::vector<IoBlock*> g_zc_quarantine;      // 等完成通知超时的块：内核可能还在读它们的页，永不归还
+thread_local std::vector<ClientData*> g_closed_clients;  // 本轮已关闭、待释放的连接
+thread_local std::vector<ClientData*> g_connections;     // 本 reactor 的所有连接（房间模式下即房间成员）
+thread_local std::vector<OffloadTask*> g_free_tasks;     // 空闲的 offload 任务对象
+thread_local std::unique_ptr<WorkerPool> g_worker_pool;  // offload 模式的 worker 线程池
+thread_local IpRateTable g_ip_rates;                     // 按源 IP 限速的状态（每个 reactor 各自统计）
+thread_local uint64_t g_ip_sweep_ms = 0;                 // 上次清理 g_ip_rates 的时间
+
+// 主/从 reactor 模式：acceptor 线程 accept 后交给从 reactor 的连接
+struct AcceptedConnection {
+    int fd;
+    struct sockaddr_in addr;
+    ConnType type;  // Client 或 ShmControl
+};
+
+// 从 reactor：独占自己的 epoll 和连接，数据路径上不和其他线程共享任何状态
+// acceptor 通过 SPSC 队列送来新连接，再写 eventfd 唤醒它
+struct SubReactor {
+    size_t index;
+    SpscQueue<AcceptedConnection> inbox;
+    int wake_fd = -1;
+    std::atomic<size_t> connections{0};   // 当前连接数（acceptor 分发时加，reactor 关闭连接时减）
+    std::atomic<bool> overloaded{false};  // 该 reactor 处于过载状态（由它自己的定时器更新，acceptor 分发时读取）
+    bool needs_wake = false;              // acceptor 本批次给它送过连接，批次结束时唤醒（仅 acceptor 访问）
+    uint64_t stats_generation_seen = 0;   // 已打印过的统计请求代数（仅该 reactor 访问）
+    std::thread thread;
+
+    explicit SubReactor(size_t index) : index(index), inbox(REACTOR_INBOX_CAPACITY) {}
+};
+
+std::vector<std::unique_ptr<SubReactor>> g_sub_reactors;  // 启动后不再修改
+std::atomic<uint64_t> g_stats_generation{0};  // 收到 SIGUSR1 时加一，从 reactor 看到变化就打印自己的统计
+thread_local SubReactor* t_reactor = nullptr;  // 当前线程所属的从 reactor（acceptor/单 reactor 为 nullptr）
+size_t g_next_reactor = 0;  // 轮询分发的下一个从 reactor（仅 acceptor 访问）
+
+// 事件循环里需要单独处理的 fd（没有的填 -1）
+struct LoopFds {
+    int server_fd = -1;   // 监听 socket
+    int unix_fd = -1;     // Unix 域监听 socket（--unix）
+    int shm_fd = -1;      // 共享内存握手的监听 socket（--shm）
+    int signal_fd = -1;   // signalfd
+    int offload_fd = -1;  // offload 结果通知的 eventfd
+    int inbox_fd = -1;    // 从 reactor 新连接通知的 eventfd
+    int timer_fd = -1;    // 周期定时器
 };
 
 // 打印客户端信息（复用你原有的逻辑）
@@ -54,9 +390,9 @@ void epoll_add_or_modify(int epoll_fd, int fd, uint32_t events, ClientData* clie
     ev.data.ptr = client_data;   // 绑定客户端数据（事件触发时可直接获取）
 
     // 先尝试修改事件（如果 FD 已注册），失败则添加（FD 未注册）
-    if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
+    if (ECHO_SYS_EPOLL_CTL(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1) {
         if (errno == ENOENT) {  // ENOENT 表示 FD 未注册，执行添加
-            if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+            if (ECHO_SYS_EPOLL_CTL(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
                 throw std::system_error(errno, std::generic_category(), "epoll_ctl 添加 FD 失败");
             }
         } else {
@@ -73,207 +409,2180 @@ void epoll_remove(int epoll_fd, int fd) {
     close(fd);  // 关闭客户端 FD
 }
 
-// 处理新客户端连接（epoll 监听到服务器 FD 的读事件时调用）
-void handle_new_connection(int server_fd, int epoll_fd) {
-    struct sockaddr_in client_addr;
-    socklen_t client_addr_len = sizeof(client_addr);
+// 根据连接状态计算应注册的 epoll 事件，和当前注册的相同时跳过 epoll_ctl
+void update_events(ClientData* client_data, int epoll_fd) {
+    uint32_t events = EPOLLET;
+    if (!client_data->read_paused && !client_data->memory_paused && !client_data->rate_paused) {
+        events |= EPOLLIN;
+    }
+    if (client_data->connecting || !client_data->out_queue.empty()) {
+        events |= EPOLLOUT;  // 有待发送数据（或等待 connect 完成）时才关注写事件
+    }
+    if (events != client_data->armed_events) {
+        epoll_add_or_modify(epoll_fd, client_data->client_fd, events, client_data);
+        client_data->armed_events = events;
+    }
+}
+
+// 与该连接交换数据的一端：回声模式是自己，代理模式是配对的另一端
+// 从它读到的数据写进这一端的 out_queue，这一端的 out_queue 积压时也是它被暂停读
+// 房间模式下数据来自所有其他成员，没有单一的来源，返回 nullptr（不做读暂停，由 slow_policy 处理积压）
+ClientData* data_peer(ClientData* client_data) {
+    switch (g_config.mode) {
+        case ServerMode::Proxy:
+            return client_data->peer;
+        case ServerMode::Room:
+            return nullptr;
+        default:
+            return client_data;
+    }
+}
+
+// 登记连接（定时器据此做空闲回收和内存预算检查，房间模式据此广播）
+void track_connection(ClientData* client_data) {
+    client_data->conn_index = g_connections.size();
+    client_data->last_active_ms = g_now_ms;
+    g_connections.push_back(client_data);
+}
+
+// 注销连接：把末尾连接换到空出的位置，O(1) 删除
+void untrack_connection(ClientData* client_data) {
+    ClientData* last = g_connections.back();
+    g_connections[client_data->conn_index] = last;
+    last->conn_index = client_data->conn_index;
+    g_connections.pop_back();
+}
+
+// CLOCK_REALTIME（纳秒），与内核软件时间戳同一时钟
+int64_t realtime_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+// 开启软件收发时间戳：接收时间戳内核对每个包都打（只有 recvmsg 带控制缓冲区时才取出），
+// 发送时间戳只在采样的 send 上通过 cmsg 单独请求；OPT_ID 让发送时间戳带上字节序号，用来和样本对应
+// TCP 上 OPT_ID 的序号从开启时的 snd_una 算起，必须在连接建立后、发送任何数据之前开启
+void enable_timestamping(ClientData* client_data) {
+    int flags = SOF_TIMESTAMPING_SOFTWARE | SOF_TIMESTAMPING_RX_SOFTWARE |
+                SOF_TIMESTAMPING_OPT_ID | SOF_TIMESTAMPING_OPT_TSONLY;
+    if (setsockopt(client_data->client_fd, SOL_SOCKET, SO_TIMESTAMPING, &flags, sizeof(flags)) == -1) {
+        std::cerr << "setsockopt SO_TIMESTAMPING 失败：" << std::strerror(errno) << std::endl;
+        return;
+    }
+    client_data->timestamping = true;
+}
+
+// 采样的读：用 recvmsg 取出最后一个包的软件接收时间戳，记录"到达 → read"，read_ns 返回读完的时间
+ssize_t traced_read(ClientData* client_data, char* buf, size_t len, int64_t& read_ns) {
+    struct iovec iov{buf, len};
+    char control[CMSG_SPACE(sizeof(struct scm_timestamping))];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+
+    ssize_t n = recvmsg(client_data->client_fd, &msg, 0);
+    if (n <= 0) {
+        return n;
+    }
+    read_ns = realtime_ns();
+    ++g_trace_stats.sampled;
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+            auto* ts = reinterpret_cast<struct scm_timestamping*>(CMSG_DATA(cm));
+            int64_t rx_ns = static_cast<int64_t>(ts->ts[0].tv_sec) * 1000000000 + ts->ts[0].tv_nsec;
+            if (rx_ns != 0) {
+                g_trace_stats.rx_to_read.record(read_ns - rx_ns);
+            }
+        }
+    }
+    return n;
+}
+
+// 采样数据已放进 sink 的待发送队列：记下它末尾在发送字节流中的位置，等 send 越过这个位置
+void start_write_trace(ClientData* sink, int64_t read_ns) {
+    if (!sink->timestamping) {
+        return;
+    }
+    if (sink->trace_state != TraceState::Idle) {
+        ++g_trace_stats.abandoned;  // 上一个样本还没等到发送时间戳（比如发送时间戳被内核丢弃），以新样本为准
+    }
+    sink->trace_state = TraceState::WaitWrite;
+    sink->trace_target = sink->bytes_sent + sink->out_bytes;
+    sink->trace_read_ns = read_ns;
+}
+
+// 发送并通过 cmsg 为这一次 send 单独请求发送软件时间戳
+ssize_t send_with_tx_timestamp(int fd, const char* data, size_t len, int flags) {
+    struct iovec iov{const_cast<char*>(data), len};
+    char control[CMSG_SPACE(sizeof(uint32_t))];
+    memset(control, 0, sizeof(control));
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    struct cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SO_TIMESTAMPING;
+    cm->cmsg_len = CMSG_LEN(sizeof(uint32_t));
+    uint32_t tsflags = SOF_TIMESTAMPING_TX_SOFTWARE;
+    memcpy(CMSG_DATA(cm), &tsflags, sizeof(tsflags));
+    return sendmsg(fd, &msg, flags);
+}
+
+void close_client(ClientData* client_data, int epoll_fd);
+void recycle_task(OffloadTask* task);
+void handle_error_queue(ClientData* client_data);
+
+// 客户端已断开，处理它的后端连接：还有数据没发给后端的发完再关闭，否则直接关闭
+// 转发的是没有分帧的字节流，无法判断后端对上一个客户端的回复是否已经发完，所以后端连接不复用
+void release_upstream(ClientData* upstream, int epoll_fd) {
+    if (!upstream->out_queue.empty()) {
+        upstream->close_after_flush = true;
+        upstream->read_paused = true;
+        update_events(upstream, epoll_fd);
+    } else {
+        close_client(upstream, epoll_fd);
+    }
+}
+
+// 关闭时还有零拷贝发送没完成：内核仍在引用这些块的页，而 fd 一关就再也收不到完成通知
+// 所以只 shutdown，fd 留在 epoll 里继续读错误队列，全部完成（或超时）后再真正关闭
+void start_zerocopy_drain(ClientData* client_data, int epoll_fd) {
+    shutdown(client_data->client_fd, SHUT_RDWR);
+    client_data->zc_draining = true;
+    client_data->zc_drain_deadline_ms = g_now_ms + ZEROCOPY_DRAIN_TIMEOUT_MS;
+    // 不再关注读写，EPOLLERR 总会上报；重新注册时错误队列里已有的通知也会触发一次
+    epoll_add_or_modify(epoll_fd, client_data->client_fd, EPOLLET, client_data);
+    client_data->armed_events = EPOLLET;
+    g_zc_draining.push_back(client_data);
+    ++g_stats.zc_drains;
+}
+
+// 关闭连接：归还所有缓冲块，从 epoll 删除，客户端数据等本轮事件处理完再释放
+// 还有零拷贝发送在途时，那些块和 fd 留到完成通知到齐再处理（见 start_zerocopy_drain）
+// 代理模式下同时处理配对的另一端
+void close_client(ClientData* client_data, int epoll_fd) {
+    if (client_data->closed) {
+        return;
+    }
+    client_data->closed = true;
+    USDT_PROBE1(close, client_data->client_fd);
+    if (client_data->capture_id != 0) {
+        g_capture_log.append(client_data->capture_id, CaptureEvent::Close);
+    }
+    for (const OutChunk& chunk : client_data->out_queue) {
+        g_buffer_pool.release(chunk.block);
+    }
+    client_data->out_queue.clear();
+    if (client_data->partial_message != nullptr) {
+        g_buffer_pool.release(client_data->partial_message);
+        client_data->partial_message = nullptr;
+    }
+    untrack_connection(client_data);
+    if (g_config.ip_rate_limited() && client_data->type == ConnType::Client) {
+        if (IpRateState* ip = g_ip_rates.find(client_data->client_addr)) {
+            --ip->connections;  // 条目留着，令牌桶回满后由定时器清理，断开重连不能绕过限速
+        }
+    }
+    if (t_reactor != nullptr && client_data->type == ConnType::Client) {
+        t_reactor->connections.fetch_sub(1, std::memory_order_relaxed);
+    }
+    // 重排窗口里已完成的结果直接回收，在途的等 worker 送回时再回收
+    for (OffloadTask* task : client_data->offload_reorder) {
+        if (task != nullptr) {
+            recycle_task(task);
+        }
+    }
+    client_data->offload_reorder.clear();
+    if (client_data->zc_pending.empty()) {
+        epoll_remove(epoll_fd, client_data->client_fd);
+        g_closed_clients.push_back(client_data);
+    } else {
+        start_zerocopy_drain(client_data, epoll_fd);
+    }
+    ++g_stats.closed;
+
+    ClientData* peer = client_data->peer;
+    if (peer == nullptr) {
+        if (client_data->type == ConnType::Upstream) {
+            // 池中还没配对的后端连接被关闭（connect 失败或后端断开），从池中移除
+            std::erase(g_idle_upstreams, client_data);
+        }
+        return;
+    }
+    client_data->peer = nullptr;
+    peer->peer = nullptr;
+    if (peer->type == ConnType::Upstream) {
+        release_upstream(peer, epoll_fd);
+    } else if (peer->out_queue.empty()) {
+        close_client(peer, epoll_fd);
+    } else {
+        // 后端已断开，把已收到的回复发完再关闭客户端
+        peer->close_after_flush = true;
+        peer->read_paused = true;
+        update_events(peer, epoll_fd);
+    }
+}
+
+// 新建一个非阻塞的后端连接（connect 完成时会触发写事件）
+ClientData* connect_upstream(int epoll_fd) {
+    int upstream_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    if (upstream_fd == -1) {
+        std::cerr << "创建后端 socket 失败：" << std::strerror(errno) << std::endl;
+        return nullptr;
+    }
+    // 开启 TCP keepalive，长时间没有数据的代理会话也能及时发现后端已经失效
+    apply_connection_options(upstream_fd, g_config.socket_profile);
+    set_int_option(upstream_fd, SOL_SOCKET, SO_KEEPALIVE, 1);
+    set_int_option(upstream_fd, IPPROTO_TCP, TCP_KEEPIDLE, BACKEND_KEEPALIVE_IDLE);
+
+    auto upstream = std::make_unique<ClientData>();
+    upstream->client_fd = upstream_fd;
+    upstream->client_ip = inet_ntoa(g_config.backend_addr.sin_addr);
+    upstream->client_port = ntohs(g_config.backend_addr.sin_port);
+    upstream->type = ConnType::Upstream;
+
+    if (connect(upstream_fd, (struct sockaddr*)&g_config.backend_addr, sizeof(g_config.backend_addr)) == -1) {
+        if (errno != EINPROGRESS) {
+            std::cerr << "连接后端失败：" << std::strerror(errno) << std::endl;
+            close(upstream_fd);
+            return nullptr;
+        }
+        upstream->connecting = true;
+    } else if (g_config.timestamp_sample != 0) {
+        enable_timestamping(upstream.get());
+    }
+    ++g_stats.upstream_connects;
+    track_connection(upstream.get());
+    update_events(upstream.get(), epoll_fd);
+    return upstream.release();
+}
+
+// 把后端连接池补到 --backend-pool 条，池里只放从未配对过客户端的新连接
+void refill_upstream_pool(int epoll_fd) {
+    while (g_idle_upstreams.size() < g_config.backend_pool_size) {
+        ClientData* upstream = connect_upstream(epoll_fd);
+        if (upstream == nullptr) {
+            return;
+        }
+        g_idle_upstreams.push_back(upstream);
+    }
+}
+
+// 为新客户端取一个后端连接：优先用池中预先建好的连接（省掉一次建连的往返），池空时新建
+ClientData* acquire_upstream(int epoll_fd) {
+    if (g_idle_upstreams.empty()) {
+        return connect_upstream(epoll_fd);
+    }
+    ClientData* upstream = g_idle_upstreams.back();
+    g_idle_upstreams.pop_back();
+    ++g_stats.upstream_pooled;
+    refill_upstream_pool(epoll_fd);
+    return upstream;
+}
+
+// 初始化连接的限速令牌桶，并在 IP 表里登记（该 IP 的第一个连接负责初始化 IP 级令牌桶）
+void init_rate_limits(ClientData* client_data) {
+    uint64_t now_us = g_now_ms * 1000;
+    client_data->byte_bucket.init(g_config.rate_bytes, g_config.rate_bytes, now_us);
+    client_data->message_bucket.init(g_config.rate_messages, g_config.rate_messages, now_us);
+    if (g_config.ip_rate_limited()) {
+        bool new_entry;
+        IpRateState& ip = g_ip_rates.insert(client_data->client_addr, new_entry);
+        if (new_entry) {
+            ip.bytes.init(g_config.ip_rate_bytes, g_config.ip_rate_bytes, now_us);
+            ip.messages.init(g_config.ip_rate_messages, g_config.ip_rate_messages, now_us);
+        }
+        ++ip.connections;
+    }
+}
+
+// 补充令牌，返回该连接本次最多能读的字节数（连接级和 IP 级取较小值）；消息令牌欠账时返回 0
+int64_t rate_allowance(ClientData* client_data) {
+    uint64_t now_us = g_now_ms * 1000;
+    client_data->byte_bucket.refill(now_us);
+    client_data->message_bucket.refill(now_us);
+    int64_t bytes = client_data->byte_bucket.available();
+    int64_t messages = client_data->message_bucket.available();
+    if (IpRateState* ip = g_config.ip_rate_limited() ? g_ip_rates.find(client_data->client_addr) : nullptr) {
+        ip->bytes.refill(now_us);
+        ip->messages.refill(now_us);
+        bytes = std::min(bytes, ip->bytes.available());
+        messages = std::min(messages, ip->messages.available());
+    }
+    return messages > 0 ? bytes : 0;
+}
+
+// 读路径的限速检查：返回本次 read 的长度上限，令牌用完时暂停读（取消 EPOLLIN，由定时器恢复）并返回 0
+size_t limit_read(ClientData* client_data, size_t space) {
+    if (!g_config.rate_limited() || client_data->type != ConnType::Client) {
+        return space;
+    }
+    int64_t allowance = rate_allowance(client_data);
+    if (allowance <= 0) {
+        client_data->rate_paused = true;
+        ++g_stats.rate_throttles;
+        return 0;
+    }
+    client_data->rate_paused = false;
+    return std::min<size_t>(space, allowance);
+}
 
-    // 接受新连接（非阻塞模式，即使没连接也不会阻塞）
-    int client_fd = accept4(server_fd, (struct sockaddr*)&client_addr, &client_addr_len, SOCK_NONBLOCK);
-    if (client_fd == -1) {
-        std::cerr << "accept 新连接失败：" << std::strerror(errno) << std::endl;
+// 扣除读到的数据对应的令牌（消息数按换行符计，只有配置了消息限速时才扫描）
+void consume_rate_tokens(ClientData* client_data, const char* data, size_t len) {
+    if (!g_config.rate_limited() || client_data->type != ConnType::Client) {
         return;
     }
+    int64_t messages = 0;
+    if (g_config.rate_messages != 0 || g_config.ip_rate_messages != 0) {
+        messages = std::count(data, data + len, '\n');
+    }
+    client_data->byte_bucket.consume(len);
+    client_data->message_bucket.consume(messages);
+    if (IpRateState* ip = g_config.ip_rate_limited() ? g_ip_rates.find(client_data->client_addr) : nullptr) {
+        ip->bytes.consume(len);
+        ip->messages.consume(messages);
+    }
+}
+
+// 清理 IP 表：没有连接且令牌桶已回满的条目和新 IP 没有区别，可以删掉
+void sweep_ip_rates() {
+    uint64_t now_us = g_now_ms * 1000;
+    g_ip_rates.retain_if([now_us](IpRateState& ip) {
+        ip.bytes.refill(now_us);
+        ip.messages.refill(now_us);
+        return ip.connections > 0 || !ip.bytes.full() || !ip.messages.full();
+    });
+}
+
+// 注册到 epoll 之前就拒绝的连接：关闭 fd，并撤销 dispatch_connection 给所属 reactor 记的连接数
+void reject_unregistered(int client_fd) {
+    close(client_fd);
+    if (t_reactor != nullptr) {
+        t_reactor->connections.fetch_sub(1, std::memory_order_relaxed);
+    }
+}
 
+// 初始化新接受的客户端并注册到 epoll
+void accept_client(int client_fd, const struct sockaddr_in& client_addr, int epoll_fd) {
     // 初始化客户端数据（用 unique_ptr 管理，自动释放内存）
     auto client_data = std::make_unique<ClientData>();
     client_data->client_fd = client_fd;
-    client_data->client_ip = inet_ntoa(client_addr.sin_addr);  // 转换 IP 为字符串
-    client_data->client_port = ntohs(client_addr.sin_port);    // 转换端口为本地字节序
+    if (client_addr.sin_family == AF_UNIX) {
+        // Unix 域连接没有 IP 和端口，按 IP 限速时所有本机连接共用一个条目
+        client_data->local = true;
+        client_data->client_ip = "unix";
+        client_data->client_port = 0;
+    } else {
+        client_data->client_ip = inet_ntoa(client_addr.sin_addr);  // 转换 IP 为字符串
+        client_data->client_port = ntohs(client_addr.sin_port);    // 转换端口为本地字节序
+        client_data->client_addr = client_addr.sin_addr.s_addr;
+        apply_connection_options(client_fd, g_config.socket_profile);
+    }
+
+    // 代理模式：为客户端配一个后端连接，拿不到就拒绝这个客户端
+    if (g_config.mode == ServerMode::Proxy) {
+        ClientData* upstream = acquire_upstream(epoll_fd);
+        if (upstream == nullptr) {
+            reject_unregistered(client_fd);
+            return;
+        }
+        client_data->peer = upstream;
+        upstream->peer = client_data.get();
+    }
+    // 拒绝的连接不登记到 IP 表，登记后的连接都会经 close_client 减回连接数
+    init_rate_limits(client_data.get());
+
+    // 开启 SO_ZEROCOPY 后 send 才能带 MSG_ZEROCOPY，内核不支持时退回普通拷贝路径
+    if (g_config.zerocopy && !client_data->local) {
+        int opt = 1;
+        if (setsockopt(client_fd, SOL_SOCKET, SO_ZEROCOPY, &opt, sizeof(opt)) == -1) {
+            std::cerr << "setsockopt SO_ZEROCOPY 失败：" << std::strerror(errno) << std::endl;
+        } else {
+            client_data->zerocopy = true;
+        }
+    }
+    if (g_config.timestamp_sample != 0 && !client_data->local) {
+        enable_timestamping(client_data.get());
+    }
+    ++g_stats.accepted;
+
+    track_connection(client_data.get());
+    if (g_capture_log.enabled()) {
+        client_data->capture_id = g_capture_log.new_connection();
+        g_capture_log.append(client_data->capture_id, CaptureEvent::Open);
+    }
 
     print_client_info(client_data.get(), "新客户端连接");
 
     // 向 epoll 注册客户端 FD 的读事件（ET 模式：EPOLLIN | EPOLLET）
-    epoll_add_or_modify(epoll_fd, client_fd, EPOLLIN | EPOLLET, client_data.release());
+    update_events(client_data.release(), epoll_fd);
     // 注意：release() 转移 unique_ptr 的所有权，epoll 事件的 data.ptr 持有裸指针，后续在客户端断开时手动释放
 }
 
-// 处理客户端读事件（客户端发数据过来）
-void handle_read_event(ClientData* client_data, int epoll_fd) {
-    char raw_buf[BUFFER_SIZE];
-    ssize_t read_bytes;
-
-    // 循环读取（ET 模式必须一次性读完所有数据，否则不会再次触发读事件）
-    while (true) {
-        memset(raw_buf, 0, sizeof(raw_buf));
-        // 非阻塞 read：数据没读完会返回 EAGAIN/EWOULDBLOCK，退出循环
-        read_bytes = read(client_data->client_fd, raw_buf, BUFFER_SIZE - 1);
+// 共享内存传输的握手连接：先只注册读事件，等客户端发来 ShmHello 和描述符
+// 共享内存会话不进 g_connections（不参与房间广播、空闲回收和按积压断开），数据只做回声
+void accept_shm_client(int control_fd, int epoll_fd) {
+    auto control = std::make_unique<ClientData>();
+    control->client_fd = control_fd;
+    control->client_ip = "shm";
+    control->client_port = 0;
+    control->type = ConnType::ShmControl;
+    control->local = true;
+    control->last_active_ms = g_now_ms;
+    ++g_stats.accepted;
+    print_client_info(control.get(), "新共享内存客户端连接");
+    update_events(control.release(), epoll_fd);
+}
 
-        if (read_bytes > 0) {
-            // 读取成功，将数据存入客户端的 read_buffer（按长度拷贝，无需手动加 \0）
-            client_data->read_buffer.assign(raw_buf, read_bytes);
-            std::cout << "收到客户端[" << client_data->client_ip << ":" << client_data->client_port
-                      << "] 数据：" << client_data->read_buffer << std::endl;
+// 关闭共享内存会话：控制连接和 eventfd 的占位数据都等本轮事件处理完再释放，释放控制连接时解除映射
+void close_shm_session(ClientData* control, int epoll_fd) {
+    if (control->closed) {
+        return;
+    }
+    control->closed = true;
+    USDT_PROBE1(close, control->client_fd);
+    if (ShmSession* session = control->shm.get()) {
+        session->notify_data->closed = true;
+        g_closed_clients.push_back(session->notify_data);
+        epoll_remove(epoll_fd, session->notify_fd);
+        close(session->peer_notify_fd);
+    }
+    if (t_reactor != nullptr) {
+        t_reactor->connections.fetch_sub(1, std::memory_order_relaxed);
+    }
+    epoll_remove(epoll_fd, control->client_fd);
+    g_closed_clients.push_back(control);
+    ++g_stats.closed;
+}
 
-            // 回声逻辑：将收到的数据存入 write_buffer，准备发送（触发写事件）
-            client_data->write_buffer = client_data->read_buffer;
-            // 注册写事件（ET 模式），后续 epoll 会触发写事件，执行发送
-            epoll_add_or_modify(epoll_fd, client_data->client_fd, EPOLLIN | EPOLLOUT | EPOLLET, client_data);
+void handle_shm_notify_event(ClientData* control);
 
-        } else if (read_bytes == 0) {
-            // read_bytes == 0 表示客户端正常断开连接
-            print_client_info(client_data, "客户端断开连接");
-            epoll_remove(epoll_fd, client_data->client_fd);
-            delete client_data;  // 释放客户端数据内存
-            return;
+// 握手：收 ShmHello 和 [memfd, 服务器 eventfd, 客户端 eventfd]，映射共享内存、注册 eventfd 后回复 ShmWelcome
+// 描述符来自客户端，类型不对时在映射或 epoll_ctl 这一步失败，只拒绝这个客户端
+void start_shm_session(ClientData* control, int epoll_fd) {
+    ShmHello hello{};
+    struct iovec iov{&hello, sizeof(hello)};
+    alignas(struct cmsghdr) char control_buf[CMSG_SPACE(sizeof(int) * SHM_HELLO_FDS)];
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control_buf;
+    msg.msg_controllen = sizeof(control_buf);
+    ssize_t n = recvmsg(control->client_fd, &msg, MSG_CMSG_CLOEXEC);
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    if (n <= 0) {
+        print_client_info(control, "共享内存客户端断开连接");
+        close_shm_session(control, epoll_fd);
+        return;
+    }
 
-        } else {
-            // read_bytes < 0 表示读取失败
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // EAGAIN/EWOULDBLOCK：非阻塞模式下数据已读完，退出循环
-                break;
+    int fds[SHM_HELLO_FDS];
+    size_t fd_count = 0;
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+            continue;
+        }
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; ++i) {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            if (fd_count < SHM_HELLO_FDS) {
+                fds[fd_count++] = fd;
             } else {
-                // 其他错误（比如网络异常），关闭连接
-                std::cerr << "读取客户端数据失败：" << std::strerror(errno) << std::endl;
-                epoll_remove(epoll_fd, client_data->client_fd);
-                delete client_data;
-                return;
+                close(fd);
             }
         }
     }
+
+    int status = 0;
+    if (n != sizeof(hello) || fd_count != SHM_HELLO_FDS || (msg.msg_flags & MSG_CTRUNC) ||
+        hello.magic != SHM_MAGIC || hello.version != SHM_VERSION) {
+        status = EPROTO;
+    }
+    auto session = std::make_unique<ShmSession>();
+    if (status == 0) {
+        try {
+            session->channel.attach(fds[0], hello.ring_size);
+            session->notify_fd = fds[1];
+            session->peer_notify_fd = fds[2];
+            set_non_blocking(session->notify_fd);
+            set_non_blocking(session->peer_notify_fd);  // 写叫醒通知时不能被客户端卡住
+            auto notify_data = std::make_unique<ClientData>();
+            notify_data->client_fd = session->notify_fd;
+            notify_data->type = ConnType::ShmNotify;
+            notify_data->peer = control;
+            epoll_add_or_modify(epoll_fd, session->notify_fd, EPOLLIN | EPOLLET, notify_data.get());
+            session->notify_data = notify_data.release();
+        } catch (const std::system_error& e) {
+            std::cerr << "共享内存握手失败：" << e.what() << std::endl;
+            status = e.code().value();
+        }
+    }
+    if (fd_count > 0) {
+        close(fds[0]);  // 映射建立后 memfd 就不需要了
+    }
+    if (status != 0) {
+        for (size_t i = 1; i < fd_count; ++i) {
+            close(fds[i]);
+        }
+    }
+
+    ShmWelcome welcome{SHM_MAGIC, status};
+    bool replied = send(control->client_fd, &welcome, sizeof(welcome), MSG_NOSIGNAL) == sizeof(welcome);
+    if (status == 0) {
+        control->shm = std::move(session);  // 之后关闭控制连接时一并关闭 eventfd
+    }
+    if (status != 0 || !replied) {
+        print_client_info(control, "共享内存握手失败，关闭连接");
+        close_shm_session(control, epoll_fd);
+        return;
+    }
+    ++g_stats.shm_sessions;
+    print_client_info(control, "共享内存会话建立，环大小 " + std::to_string(hello.ring_size));
+    // 新会话的 waiting 标记都是 0，客户端不会主动叫醒服务器：先处理一轮，读空后挂上标记
+    handle_shm_notify_event(control);
 }
 
-// 处理客户端写事件（向客户端发送数据）
-void handle_write_event(ClientData* client_data, int epoll_fd) {
-    const char* data = client_data->write_buffer.c_str();
-    size_t data_len = client_data->write_buffer.size();
-    ssize_t write_bytes;
-    size_t total_written = 0;
+// 控制连接可读：握手前是 ShmHello，握手后客户端不会再发数据，只可能是对端关闭
+void handle_shm_control_event(ClientData* control, int epoll_fd) {
+    if (control->shm == nullptr) {
+        start_shm_session(control, epoll_fd);
+        return;
+    }
+    char buf[64];
+    ssize_t n = read(control->client_fd, buf, sizeof(buf));
+    if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        return;
+    }
+    print_client_info(control, n == 0 ? "共享内存客户端断开连接" : "共享内存控制连接收到意外数据，关闭会话");
+    close_shm_session(control, epoll_fd);
+}
 
-    // 循环发送（ET 模式必须一次性写完所有数据）
-    while (total_written < data_len) {
-        // 非阻塞 write：数据没写完会返回 EAGAIN/EWOULDBLOCK，退出循环
-        write_bytes = write(client_data->client_fd, data + total_written, data_len - total_written);
+// 客户端写了服务器的 eventfd（有新数据，或者服务器之前写满了回声环、现在有空间了）
+// 把请求环里的数据直接拷进回声环，两边都处理不下去时挂上 waiting 标记再睡，等客户端下次叫醒
+void handle_shm_notify_event(ClientData* control) {
+    ShmSession* session = control->shm.get();
+    uint64_t count;
+    ssize_t ret = read(session->notify_fd, &count, sizeof(count));
+    (void)ret;
+    ++g_stats.shm_wakeups;
+    control->last_active_ms = g_now_ms;
 
-        if (write_bytes > 0) {
-            total_written += write_bytes;
-        } else if (write_bytes == 0) {
-            // 写入 0 字节，无意义，退出循环
+    ShmRing& in = session->channel.to_server;
+    ShmRing& out = session->channel.to_client;
+    bool wake_client = false;
+    size_t moved = 0;
+    while (true) {
+        if (moved >= SHM_EVENT_BUDGET) {
+            // 还有数据：给自己的 eventfd 记一次，下一轮 epoll_wait 接着处理，不饿死其他连接
+            uint64_t one = 1;
+            ret = write(session->notify_fd, &one, sizeof(one));
             break;
-        } else {
-            // 写入失败
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                // 数据暂时写不完，下次触发写事件再写
+        }
+        size_t span_len;
+        const char* span = in.read_span(span_len);
+        if (span_len == 0) {
+            if (in.prepare_read_wait()) {
+                break;
+            }
+            continue;
+        }
+        size_t written = out.write(span, std::min(span_len, SHM_EVENT_BUDGET - moved), wake_client);
+        if (written == 0) {
+            if (out.prepare_write_wait()) {
                 break;
-            } else {
-                // 其他错误，关闭连接
-                std::cerr << "向客户端发送数据失败：" << std::strerror(errno) << std::endl;
-                epoll_remove(epoll_fd, client_data->client_fd);
-                delete client_data;
-                return;
             }
+            continue;
         }
+        wake_client = in.consume(written) || wake_client;
+        moved += written;
     }
-
-    // 数据全部发送完成，清空 write_buffer，取消写事件（只保留读事件）
-    if (total_written == data_len) {
-        std::cout << "向客户端[" << client_data->client_ip << ":" << client_data->client_port
-                  << "] 回声成功：" << client_data->write_buffer << std::endl;
-        client_data->write_buffer.clear();
-        client_data->read_buffer.clear();
-        // 取消写事件，只保留读事件（等待客户端下次发数据）
-        epoll_add_or_modify(epoll_fd, client_data->client_fd, EPOLLIN | EPOLLET, client_data);
+    if (wake_client) {
+        uint64_t one = 1;
+        ret = write(session->peer_notify_fd, &one, sizeof(one));
+        ++g_stats.shm_signals;
     }
+    g_stats.shm_bytes += moved;
+    g_stats.bytes_read += moved;
+    g_stats.bytes_written += moved;
 }
 
-// 初始化服务器 socket
-int init_server_socket() {
-    // 创建 socket（TCP 协议）
-    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (server_fd == -1) {
-        throw std::system_error(errno, std::generic_category(), "创建 socket 失败");
+// 在当前 reactor 上接管一个新连接
+void adopt_connection(int client_fd, const struct sockaddr_in& client_addr, ConnType type, int epoll_fd) {
+    if (type == ConnType::ShmControl) {
+        accept_shm_client(client_fd, epoll_fd);
+    } else {
+        accept_client(client_fd, client_addr, epoll_fd);
     }
+}
 
-    // 设置端口复用（避免服务器重启时端口被占用）
-    int opt = 1;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt)) == -1) {
-        throw std::system_error(errno, std::generic_category(), "setsockopt 失败");
+// 主/从模式：acceptor 把新连接交给一个从 reactor，所有队列都满时拒绝连接
+// 开启过载保护时跳过处于过载状态的 reactor
+void dispatch_connection(int client_fd, const struct sockaddr_in& client_addr, ConnType type) {
+    size_t count = g_sub_reactors.size();
+    size_t start = g_next_reactor;
+    if (g_config.dispatch == DispatchPolicy::LeastLoad) {
+        for (size_t i = 0; i < count; ++i) {
+            if (g_sub_reactors[i]->connections.load(std::memory_order_relaxed) <
+                g_sub_reactors[start]->connections.load(std::memory_order_relaxed)) {
+                start = i;
+            }
+        }
     }
+    g_next_reactor = (start + 1) % count;
 
-    // 绑定端口和 IP
-    struct sockaddr_in server_addr;
-    memset(&server_addr, 0, sizeof(server_addr));
-    server_addr.sin_family = AF_INET;         // IPv4
-    server_addr.sin_addr.s_addr = INADDR_ANY; // 监听所有网卡 IP
-    server_addr.sin_port = htons(PORT);       // 端口转换为网络字节序
-
-    if (bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
-        throw std::system_error(errno, std::generic_category(), "bind 端口失败");
+    for (size_t tries = 0; tries < count; ++tries) {
+        SubReactor* reactor = g_sub_reactors[(start + tries) % count].get();
+        if (g_config.overload_policy != OverloadPolicy::None && reactor->overloaded.load(std::memory_order_relaxed)) {
+            continue;
+        }
+        if (reactor->inbox.push({client_fd, client_addr, type})) {
+            reactor->connections.fetch_add(1, std::memory_order_relaxed);
+            reactor->needs_wake = true;
+            ++g_stats.dispatched;
+            return;
+        }
     }
+    std::cerr << "所有 reactor 的新连接队列已满或处于过载，拒绝连接" << std::endl;
+    close(client_fd);
+    ++g_stats.rejected;
+}
 
-    // 开始监听（backlog=128 表示等待队列最大长度）
-    if (listen(server_fd, 128) == -1) {
-        throw std::system_error(errno, std::generic_category(), "listen 失败");
+// 是否停止接收新连接：单 reactor 看自己的过载状态，acceptor 看是否所有从 reactor 都过载
+bool admission_closed() {
+    if (g_config.overload_policy == OverloadPolicy::None) {
+        return false;
     }
-
-    // 设置服务器 FD 为非阻塞（配合 epoll ET 模式）
-    set_non_blocking(server_fd);
-
-    std::cout << "服务器初始化成功，监听端口：" << PORT << std::endl;
-    return server_fd;
+    if (g_sub_reactors.empty()) {
+        return g_loop_monitor.overloaded;
+    }
+    for (auto& reactor : g_sub_reactors) {
+        if (!reactor->overloaded.load(std::memory_order_relaxed)) {
+            return false;
+        }
+    }
+    return true;
 }
 
-int main() {
-    try {
-        // 1. 初始化服务器 socket
-        int server_fd = init_server_socket();
+// 过载时拒绝新连接：SO_LINGER 超时为 0 时 close 直接发 RST，客户端立即得到 ECONNRESET
+void reject_connection(int client_fd) {
+    struct linger lg{1, 0};
+    setsockopt(client_fd, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));
+    close(client_fd);
+    ++g_stats.overload_rejected;
+}
 
-        // 2. 创建 epoll 实例（参数大于 0 即可，现代 Linux 忽略该参数）
-        int epoll_fd = epoll_create1(0);
-        if (epoll_fd == -1) {
-            throw std::system_error(errno, std::generic_category(), "epoll_create1 失败");
+// 处理新客户端连接（epoll 监听到监听 socket 的读事件时调用）
+// TCP 和 --unix 的监听 socket 接受普通连接，--shm 的接受共享内存握手连接（type 为 ShmControl）
+void handle_new_connection(int server_fd, ConnType type, int epoll_fd) {
+    // 过载保护：PauseAccept 策略下连接留在 backlog 里，由定时器在恢复后再调用本函数接收
+    bool reject = admission_closed();
+    if (reject && g_config.overload_policy == OverloadPolicy::PauseAccept) {
+        if (!g_loop_monitor.accept_paused) {
+            g_loop_monitor.accept_paused = true;
+            ++g_stats.accept_pauses;
         }
+        return;
+    }
 
-        // 3. 向 epoll 注册服务器 FD 的读事件（监听新连接，ET 模式）
-        auto server_data = std::make_unique<ClientData>();  // 服务器 FD 绑定的占位数据
-        server_data->client_fd = server_fd;
-        epoll_add_or_modify(epoll_fd, server_fd, EPOLLIN | EPOLLET, server_data.get());
+    // ET 模式下一次事件可能对应多个已完成的连接，循环 accept 直到 EAGAIN
+    while (true) {
+        struct sockaddr_in client_addr{};  // Unix 域连接只会填 sin_family
+        socklen_t client_addr_len = sizeof(client_addr);
 
-        // 4. 循环等待 epoll 事件（服务器主循环）
-        struct epoll_event events[MAX_EVENTS];  // 存储就绪事件的数组
-        while (true) {
-            // 阻塞等待事件触发（EPOLL_TIMEOUT=-1 无限阻塞）
-            int ready_events = epoll_wait(epoll_fd, events, MAX_EVENTS, EPOLL_TIMEOUT);
-            if (ready_events == -1) {
-                if (errno == EINTR) {  // EINTR：被信号中断（比如 Ctrl+C），忽略继续循环
-                    continue;
-                }
-                throw std::system_error(errno, std::generic_category(), "epoll_wait 失败");
-            }
-
-            // 遍历所有就绪事件
-            for (int i = 0; i < ready_events; ++i) {
-                ClientData* data = static_cast<ClientData*>(events[i].data.ptr);
-                int fd = data->client_fd;
-
-                // 事件类型判断
-                if (fd == server_fd) {
-                    // 服务器 FD 的读事件：新客户端连接
-                    handle_new_connection(server_fd, epoll_fd);
-                } else {
-                    if (events[i].events & EPOLLIN) {
-                        // 客户端 FD 的读事件：客户端发数据
-                        handle_read_event(data, epoll_fd);
-                    }
-                    if (events[i].events & EPOLLOUT) {
-                        // 客户端 FD 的写事件：可以向客户端发数据
-                        handle_write_event(data, epoll_fd);
-                    }
-                }
+        // 接受新连接（非阻塞模式，即使没连接也不会阻塞）
+        int client_fd = accept4(server_fd, (struct sockaddr*)&client_addr, &client_addr_len, SOCK_NONBLOCK);
+        if (client_fd == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "accept 新连接失败：" << std::strerror(errno) << std::endl;
             }
+            break;
+        }
+        USDT_PROBE1(accept, client_fd);
+        if (reject) {
+            reject_connection(client_fd);
+        } else if (g_sub_reactors.empty()) {
+            adopt_connection(client_fd, client_addr, type, epoll_fd);
+        } else {
+            dispatch_connection(client_fd, client_addr, type);
         }
+    }
+
+    // 主/从模式：本批次 accept 完再统一唤醒，每个从 reactor 最多一次 eventfd 写入
+    for (auto& reactor : g_sub_reactors) {
+        if (reactor->needs_wake) {
+            reactor->needs_wake = false;
+            uint64_t one = 1;
+            ssize_t ret = write(reactor->wake_fd, &one, sizeof(one));
+            (void)ret;
+        }
+    }
+}
+
+// 该连接下一次读应使用的块容量
+size_t read_capacity(const ClientData* client_data) {
+    return SIZE_CLASSES[client_data->read_class];
+}
+
+// 按一次读事件读到的总字节数调整读缓冲分级：一块装不下就升一级，连续多次用不满下一级才降一级
+void adapt_read_class(ClientData* client_data, size_t event_bytes) {
+    uint8_t& size_class = client_data->read_class;
+    if (event_bytes >= SIZE_CLASSES[size_class] && size_class + 1 < SIZE_CLASS_COUNT) {
+        ++size_class;
+        client_data->small_reads = 0;
+    } else if (size_class > 0 && event_bytes <= SIZE_CLASSES[size_class - 1] / 2) {
+        if (++client_data->small_reads >= READ_SHRINK_EVENTS) {
+            --size_class;
+            client_data->small_reads = 0;
+        }
+    } else {
+        client_data->small_reads = 0;
+    }
+}
+
+// 超出内存预算拿不到新块：暂停读，由定时器在预算恢复后重新打开
+void pause_for_memory(ClientData* client_data) {
+    if (!client_data->memory_paused) {
+        client_data->memory_paused = true;
+        ++g_stats.memory_pauses;
+    }
+}
+
+// 把块中 [offset, size) 的数据搬到容量为 capacity 的新块里，旧块的引用随之释放
+IoBlock* resize_block(IoBlock* block, size_t offset, size_t capacity) {
+    IoBlock* resized = g_buffer_pool.acquire(capacity);
+    resized->size = block->size - offset;
+    memcpy(resized->data, block->data + offset, resized->size);
+    g_buffer_pool.release(block);
+    return resized;
+}
+
+// 获取可继续写入的队尾块：队尾块没有被其他地方引用（比如零拷贝发送中）且还有空间时直接追加，否则取新块
+// budgeted 为 true 时新块受全局内存预算约束，超出预算且池中没有空闲块时返回 nullptr
+IoBlock* writable_tail_block(ClientData* client_data, size_t capacity, bool budgeted) {
+    if (!client_data->out_queue.empty()) {
+        IoBlock* tail = client_data->out_queue.back().block;
+        if (tail->refcnt == 1 && tail->space() > 0) {
+            return tail;
+        }
+    }
+    IoBlock* block = budgeted ? g_buffer_pool.try_acquire(capacity) : g_buffer_pool.acquire(capacity);
+    if (block != nullptr) {
+        client_data->out_queue.push_back({block, 0});
+    }
+    return block;
+}
+
+// 队尾块一个字节都没写进去时归还给池（避免空块留在待发送队列里）
+void trim_empty_tail(ClientData* client_data) {
+    if (!client_data->out_queue.empty()) {
+        OutChunk& tail = client_data->out_queue.back();
+        if (tail.block->size == tail.offset) {
+            g_buffer_pool.release(tail.block);
+            client_data->out_queue.pop_back();
+        }
+    }
+}
+
+// 处理客户端读事件（客户端发数据过来），连接被关闭时返回 false
+// 读到的数据放进 data_peer 的待发送队列：回声模式发回自己，代理模式转发给另一端
+bool handle_read_event(ClientData* client_data, int epoll_fd) {
+    ClientData* sink = data_peer(client_data);
+    if (sink == nullptr) {
+        if (client_data->type == ConnType::Upstream) {
+            // 池中还没配对或客户端已断开的后端连接可读：后端断开或发来了没有接收方的数据，直接关闭
+            close_client(client_data, epoll_fd);
+            return false;
+        }
+        return true;  // 后端已断开的客户端只等剩余数据发完，不再读
+    }
+    ssize_t read_bytes;
+    size_t event_bytes = 0;
+    client_data->last_active_ms = g_now_ms;
+    // 时间戳追踪：按间隔采样本次事件的第一次读
+    bool sample = client_data->timestamping && ++g_trace_reads % g_config.timestamp_sample == 0;
+    int64_t read_ns = 0;
+
+    // 循环读取（ET 模式必须一次性读完所有数据，否则不会再次触发读事件）
+    while (true) {
+        // 背压：对端积压超过高水位就暂停读，等它发到低水位以下再恢复
+        if (sink->out_bytes >= HIGH_WATERMARK) {
+            client_data->read_paused = true;
+            ++g_stats.read_pauses;
+            break;
+        }
+
+        // 直接读进待发送队列的块里，回声时无需再拷贝一次
+        IoBlock* block = writable_tail_block(sink, read_capacity(client_data), true);
+        if (block == nullptr) {
+            pause_for_memory(client_data);
+            break;
+        }
+        size_t read_len = limit_read(client_data, block->space());
+        if (read_len == 0) {
+            trim_empty_tail(sink);
+            break;
+        }
+        // 非阻塞 read：数据没读完会返回 EAGAIN/EWOULDBLOCK，退出循环
+        if (sample) {
+            read_bytes = traced_read(client_data, block->data + block->size, read_len, read_ns);
+        } else {
+            read_bytes = ECHO_SYS_READ(client_data->client_fd, block->data + block->size, read_len);
+        }
+
+        if (read_bytes > 0) {
+            if (g_config.verbose) {
+                std::cout << "收到客户端[" << client_data->client_ip << ":" << client_data->client_port
+                          << "] 数据：" << std::string_view(block->data + block->size, read_bytes) << std::endl;
+            }
+            USDT_PROBE2(read, client_data->client_fd, read_bytes);
+            if (client_data->capture_id != 0) {
+                g_capture_log.append(client_data->capture_id, CaptureEvent::Read, block->data + block->size, read_bytes);
+            }
+            consume_rate_tokens(client_data, block->data + block->size, read_bytes);
+            block->size += read_bytes;
+            sink->out_bytes += read_bytes;
+            event_bytes += read_bytes;
+            g_stats.bytes_read += read_bytes;
+            if (sample) {
+                start_write_trace(sink, read_ns);
+                sample = false;
+            }
+            continue;
+        }
+
+        trim_empty_tail(sink);
+        if (read_bytes == 0) {
+            // read_bytes == 0 表示客户端正常断开连接
+            print_client_info(client_data, "客户端断开连接");
+            close_client(client_data, epoll_fd);
+            return false;
+        }
+
+        // read_bytes < 0 表示读取失败
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            // EAGAIN/EWOULDBLOCK：非阻塞模式下数据已读完，退出循环
+            USDT_PROBE2(eagain, client_data->client_fd, USDT_DIR_READ);
+            break;
+        } else {
+            // 其他错误（比如网络异常），关闭连接
+            std::cerr << "读取客户端数据失败：" << std::strerror(errno) << std::endl;
+            close_client(client_data, epoll_fd);
+            return false;
+        }
+    }
+
+    adapt_read_class(client_data, event_bytes);
+
+    // 回声逻辑：有待发送数据时注册写事件（ET 模式），后续 epoll 会触发写事件，执行发送
+    update_events(sink, epoll_fd);
+    if (sink != client_data) {
+        update_events(client_data, epoll_fd);
+    }
+    return true;
+}
+
+// 房间模式：把一条消息投递给除发送者以外的所有成员
+// 消息只存一份，每个成员的 out_queue 持有同一个块的引用，内存开销与订阅者数量无关
+void publish_to_room(ClientData* sender, IoBlock* message, int epoll_fd) {
+    ++g_stats.room_messages;
+    // 倒序遍历：断开慢订阅者时 untrack_connection 会把末尾成员换到当前位置，而末尾成员已经处理过
+    for (size_t i = g_connections.size(); i-- > 0;) {
+        ClientData* member = g_connections[i];
+        if (member == sender) {
+            continue;
+        }
+        if (member->out_bytes + message->size > g_config.room_max_lag) {
+            if (g_config.slow_policy == SlowPolicy::Drop) {
+                ++g_stats.room_dropped;
+                print_client_info(member, "订阅者积压过多，断开连接");
+                close_client(member, epoll_fd);
+            } else {
+                ++g_stats.room_lagged;
+            }
+            continue;
+        }
+        g_buffer_pool.retain(message);
+        member->out_queue.push_back({message, 0});
+        member->out_bytes += message->size;
+        ++g_stats.room_deliveries;
+        update_events(member, epoll_fd);
+    }
+}
+
+// 按行处理的模式（房间、offload）收到完整消息后的回调：block 中 [0, size) 都是完整的行
+using LinesHandler = void (*)(ClientData* client_data, IoBlock* block, int epoll_fd);
+
+// 把 partial_message 中最后一个换行符之前的完整消息交给 handler，之后的半行拷贝到新块里继续攒
+// force 为 true 时（一行超过了最大一级块）没有换行符也整块交出去
+// 交出去的块不再修改（房间模式下其他连接还在引用它）
+void flush_complete_lines(ClientData* client_data, int epoll_fd, LinesHandler handler, bool force) {
+    IoBlock* block = client_data->partial_message;
+    const char* last_newline = static_cast<const char*>(memrchr(block->data, '\n', block->size));
+    size_t message_len;
+    if (last_newline != nullptr) {
+        message_len = last_newline - block->data + 1;
+    } else if (force) {
+        message_len = block->size;
+    } else {
+        return;
+    }
+
+    IoBlock* rest = nullptr;
+    if (message_len < block->size) {
+        rest = g_buffer_pool.acquire(std::max(block->size - message_len, read_capacity(client_data)));
+        rest->size = block->size - message_len;
+        memcpy(rest->data, block->data + message_len, rest->size);
+    }
+    block->size = message_len;
+    client_data->partial_message = rest;
+    handler(client_data, block, epoll_fd);
+    g_buffer_pool.release(block);
+}
+
+// 按行处理模式的读事件：数据先攒在 partial_message 里，切出完整的行后交给 handler
+bool handle_line_read_event(ClientData* client_data, int epoll_fd, LinesHandler handler) {
+    ssize_t read_bytes;
+    size_t event_bytes = 0;
+    client_data->last_active_ms = g_now_ms;
+    // 时间戳追踪：按行处理的模式输出和输入不是逐字节对应的，只统计"到达 → read"
+    bool sample = client_data->timestamping && ++g_trace_reads % g_config.timestamp_sample == 0;
+    int64_t read_ns = 0;
+
+    while (!client_data->read_paused && !client_data->memory_paused) {
+        if (client_data->partial_message == nullptr) {
+            client_data->partial_message = g_buffer_pool.try_acquire(read_capacity(client_data));
+            if (client_data->partial_message == nullptr) {
+                pause_for_memory(client_data);
+                break;
+            }
+        }
+        IoBlock* block = client_data->partial_message;
+        if (block->space() == 0) {
+            // 块满了：先把完整的行交出去；一行比当前块还长时换大一级的块，已是最大一级才整块交出
+            flush_complete_lines(client_data, epoll_fd, handler, block->capacity >= IO_BLOCK_SIZE);
+            if (client_data->partial_message == block) {
+                client_data->partial_message = resize_block(block, 0, SIZE_CLASSES[block->size_class + 1]);
+            }
+            continue;
+        }
+
+        size_t read_len = limit_read(client_data, block->space());
+        if (read_len == 0) {
+            break;
+        }
+        if (sample) {
+            read_bytes = traced_read(client_data, block->data + block->size, read_len, read_ns);
+            sample = false;
+        } else {
+            read_bytes = ECHO_SYS_READ(client_data->client_fd, block->data + block->size, read_len);
+        }
+        if (read_bytes > 0) {
+            if (g_config.verbose) {
+                std::cout << "收到客户端[" << client_data->client_ip << ":" << client_data->client_port
+                          << "] 数据：" << std::string_view(block->data + block->size, read_bytes) << std::endl;
+            }
+            USDT_PROBE2(read, client_data->client_fd, read_bytes);
+            if (client_data->capture_id != 0) {
+                g_capture_log.append(client_data->capture_id, CaptureEvent::Read, block->data + block->size, read_bytes);
+            }
+            consume_rate_tokens(client_data, block->data + block->size, read_bytes);
+            block->size += read_bytes;
+            event_bytes += read_bytes;
+            g_stats.bytes_read += read_bytes;
+        } else if (read_bytes == 0) {
+            print_client_info(client_data, "客户端断开连接");
+            close_client(client_data, epoll_fd);
+            return false;
+        } else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            USDT_PROBE2(eagain, client_data->client_fd, USDT_DIR_READ);
+            break;
+        } else {
+            std::cerr << "读取客户端数据失败：" << std::strerror(errno) << std::endl;
+            close_client(client_data, epoll_fd);
+            return false;
+        }
+    }
+
+    adapt_read_class(client_data, event_bytes);
+    if (client_data->partial_message != nullptr) {
+        flush_complete_lines(client_data, epoll_fd, handler, false);
+    }
+    // handler 可能暂停了读（offload 模式积压过多）
+    update_events(client_data, epoll_fd);
+    return true;
+}
+
+// offload 模式的请求处理（在 worker 线程执行）：回复原内容并附上 CRC32 校验值
+void process_request(OffloadTask* task) {
+    static constexpr auto crc_table = [] {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+            }
+            table[i] = crc;
+        }
+        return table;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (unsigned char c : task->request) {
+        crc = crc_table[(crc ^ c) & 0xFF] ^ (crc >> 8);
+    }
+    crc ^= 0xFFFFFFFFu;
+
+    char suffix[16];
+    int suffix_len = snprintf(suffix, sizeof(suffix), " %08x\n", crc);
+    task->result.assign(task->request);
+    task->result.append(suffix, suffix_len);
+}
+
+// 取一个空闲的任务对象（任务对象循环使用，字符串的容量也跟着复用）
+OffloadTask* acquire_task() {
+    if (g_free_tasks.empty()) {
+        return new OffloadTask();
+    }
+    OffloadTask* task = g_free_tasks.back();
+    g_free_tasks.pop_back();
+    return task;
+}
+
+void recycle_task(OffloadTask* task) {
+    task->owner = nullptr;
+    task->next = nullptr;
+    g_free_tasks.push_back(task);
+}
+
+// 把 data 追加到连接的待发送队列（小结果会合并进同一个块，一次 send 发出多条回复）
+void append_output(ClientData* client_data, const char* data, size_t len) {
+    while (len > 0) {
+        IoBlock* block = writable_tail_block(client_data, read_capacity(client_data), false);
+        size_t n = std::min(len, block->space());
+        memcpy(block->data + block->size, data, n);
+        block->size += n;
+        client_data->out_bytes += n;
+        data += n;
+        len -= n;
+    }
+}
+
+// 一个请求处理完毕：放进该连接的重排窗口，再按序号顺序把已就绪的结果写进待发送队列
+void complete_task(ClientData* client_data, OffloadTask* task) {
+    client_data->offload_reorder[task->seq - client_data->offload_deliver_seq] = task;
+    while (!client_data->offload_reorder.empty() && client_data->offload_reorder.front() != nullptr) {
+        OffloadTask* ready = client_data->offload_reorder.front();
+        client_data->offload_reorder.pop_front();
+        ++client_data->offload_deliver_seq;
+        append_output(client_data, ready->result.data(), ready->result.size());
+        recycle_task(ready);
+    }
+}
+
+// offload 模式：把完整的行逐条交给 worker；所有 worker 队列都满时在 reactor 上直接处理（退化但不丢请求）
+void submit_lines(ClientData* client_data, IoBlock* block, int epoll_fd) {
+    const char* pos = block->data;
+    const char* end = block->data + block->size;
+    while (pos < end) {
+        const char* newline = static_cast<const char*>(memchr(pos, '\n', end - pos));
+        const char* line_end = newline != nullptr ? newline : end;
+
+        OffloadTask* task = acquire_task();
+        task->owner = client_data;
+        task->seq = client_data->offload_next_seq++;
+        task->request.assign(pos, line_end - pos);
+        client_data->offload_reorder.push_back(nullptr);
+        ++g_stats.offload_submitted;
+
+        if (g_worker_pool->submit(task)) {
+            ++client_data->offload_inflight;
+        } else {
+            ++g_stats.offload_inline;
+            process_request(task);
+            complete_task(client_data, task);
+        }
+        pos = line_end + 1;
+    }
+
+    // 背压：在途请求或待发送数据过多时暂停读
+    if (client_data->offload_inflight >= OFFLOAD_MAX_INFLIGHT || client_data->out_bytes >= HIGH_WATERMARK) {
+        client_data->read_paused = true;
+        ++g_stats.read_pauses;
+    }
+    update_events(client_data, epoll_fd);
+}
+
+// 处理 worker 送回的结果（notify eventfd 可读时调用）
+void handle_offload_results(int epoll_fd) {
+    OffloadTask* task = g_worker_pool->take_results();
+    while (task != nullptr) {
+        OffloadTask* next = task->next;
+        ClientData* client_data = static_cast<ClientData*>(task->owner);
+        --client_data->offload_inflight;
+        ++g_stats.offload_completed;
+
+        if (client_data->closed) {
+            // 连接已关闭：丢弃结果，最后一个在途请求回来时释放连接
+            recycle_task(task);
+            if (client_data->offload_inflight == 0 && client_data->offload_detached) {
+                delete client_data;
+            }
+        } else {
+            complete_task(client_data, task);
+            if (client_data->read_paused && client_data->offload_inflight <= OFFLOAD_MAX_INFLIGHT / 2 &&
+                client_data->out_bytes <= LOW_WATERMARK) {
+                client_data->read_paused = false;
+            }
+            update_events(client_data, epoll_fd);
+        }
+        task = next;
+    }
+}
+
+// 处理客户端写事件（向客户端发送数据），连接被关闭时返回 false
+// 超过阈值的数据块用 MSG_ZEROCOPY 发送，块的引用转交给 zc_pending，直到内核通知完成才归还
+bool handle_write_event(ClientData* client_data, int epoll_fd) {
+    // 后端连接的非阻塞 connect 完成，检查结果
+    if (client_data->connecting) {
+        int err = 0;
+        socklen_t err_len = sizeof(err);
+        if (getsockopt(client_data->client_fd, SOL_SOCKET, SO_ERROR, &err, &err_len) == -1) {
+            err = errno;
+        }
+        if (err != 0) {
+            std::cerr << "连接后端失败：" << std::strerror(err) << std::endl;
+            close_client(client_data, epoll_fd);
+            return false;
+        }
+        client_data->connecting = false;
+        if (g_config.timestamp_sample != 0) {
+            enable_timestamping(client_data);
+        }
+        print_client_info(client_data, "后端连接建立");
+    }
+    client_data->last_active_ms = g_now_ms;
+
+    size_t total_written = 0;
+    bool force_copy = false;  // 零拷贝发送遇到 ENOBUFS 时，本块改走拷贝路径
+    // 一次要发多个块时先 cork，避免每个块单独成包，发完统一解除
+    bool corked = g_config.socket_profile.cork && !client_data->local && client_data->out_queue.size() > 1;
+    if (corked) {
+        set_cork(client_data->client_fd, true);
+    }
+
+    // 循环发送（ET 模式必须一次性写完所有数据）
+    while (!client_data->out_queue.empty()) {
+        OutChunk& chunk = client_data->out_queue.front();
+        IoBlock* block = chunk.block;
+        size_t data_len = block->size - chunk.offset;
+        bool use_zerocopy = client_data->zerocopy && !force_copy && data_len >= g_config.zerocopy_threshold;
+        int flags = MSG_NOSIGNAL | (use_zerocopy ? MSG_ZEROCOPY : 0);
+
+        // 非阻塞 send：数据没写完会返回 EAGAIN/EWOULDBLOCK，退出循环
+        // 时间戳追踪：这次 send 会越过采样数据的末尾时，为它请求发送时间戳
+        bool want_tx_timestamp = client_data->trace_state == TraceState::WaitWrite &&
+                                 client_data->bytes_sent + data_len >= client_data->trace_target;
+        // 在 send 之前打点：回环等路径上发送时间戳是在 send 调用内部同步生成的
+        int64_t write_ns = want_tx_timestamp ? realtime_ns() : 0;
+        ssize_t write_bytes = want_tx_timestamp
+            ? send_with_tx_timestamp(client_data->client_fd, block->data + chunk.offset, data_len, flags)
+            : ECHO_SYS_SEND(client_data->client_fd, block->data + chunk.offset, data_len, flags);
+
+        if (write_bytes > 0) {
+            USDT_PROBE3(write, client_data->client_fd, write_bytes, static_cast<size_t>(write_bytes) < data_len);
+            if (client_data->capture_id != 0) {
+                g_capture_log.append(client_data->capture_id, CaptureEvent::Write, nullptr, write_bytes);
+            }
+            if (use_zerocopy) {
+                // 每次成功的零拷贝 send 对应内核的一个序号，完成通知按序号区间返回
+                g_buffer_pool.retain(block);
+                client_data->zc_pending.push_back({client_data->zc_next_seq++, block});
+                ++g_stats.zc_sends;
+                g_stats.zc_bytes += write_bytes;
+            }
+            force_copy = false;
+            client_data->bytes_sent += write_bytes;
+            if (want_tx_timestamp && client_data->bytes_sent >= client_data->trace_target) {
+                client_data->trace_write_ns = write_ns;
+                g_trace_stats.read_to_write.record(client_data->trace_write_ns - client_data->trace_read_ns);
+                client_data->trace_state = TraceState::WaitTx;
+            }
+            total_written += write_bytes;
+            client_data->out_bytes -= write_bytes;
+            g_stats.bytes_written += write_bytes;
+            chunk.offset += write_bytes;
+            if (chunk.offset == block->size) {
+                g_buffer_pool.release(block);
+                client_data->out_queue.pop_front();
+            }
+        } else if (write_bytes == 0) {
+            // 写入 0 字节，无意义，退出循环
+            break;
+        } else {
+            // 写入失败
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                // 数据暂时写不完，下次触发写事件再写
+                USDT_PROBE2(eagain, client_data->client_fd, USDT_DIR_WRITE);
+                break;
+            } else if (errno == ENOBUFS && use_zerocopy) {
+                // 超出 optmem 限制，无法再钉住更多页面，这一块改用普通拷贝发送
+                ++g_stats.zc_fallbacks;
+                force_copy = true;
+            } else {
+                // 其他错误，关闭连接
+                std::cerr << "向客户端发送数据失败：" << std::strerror(errno) << std::endl;
+                close_client(client_data, epoll_fd);
+                return false;
+            }
+        }
+    }
+
+    if (corked) {
+        set_cork(client_data->client_fd, false);
+    }
+
+    // 积压降到低水位以下，恢复数据来源一端的读
+    ClientData* source = data_peer(client_data);
+    if (source != nullptr && source->read_paused && !source->close_after_flush &&
+        client_data->out_bytes <= LOW_WATERMARK && source->offload_inflight <= OFFLOAD_MAX_INFLIGHT / 2) {
+        source->read_paused = false;
+        update_events(source, epoll_fd);
+    }
+
+    // 数据全部发送完成，取消写事件（只保留读事件）
+    if (client_data->out_queue.empty()) {
+        if (g_config.verbose) {
+            std::cout << "向客户端[" << client_data->client_ip << ":" << client_data->client_port
+                      << "] 回声成功，字节数：" << total_written << std::endl;
+        }
+        if (client_data->close_after_flush) {
+            print_client_info(client_data, "剩余数据发送完毕，关闭连接");
+            close_client(client_data, epoll_fd);
+            return false;
+        }
+    }
+    // 取消写事件，只保留读事件（等待客户端下次发数据）
+    update_events(client_data, epoll_fd);
+    return true;
+}
+
+// 发送时间戳到达：序号（最后一个字节在发送流中的位置）越过采样数据末尾时记录"send → 交给驱动"
+void handle_tx_timestamp(ClientData* client_data, uint32_t key, const struct timespec& ts) {
+    if (client_data->trace_state != TraceState::WaitTx ||
+        static_cast<int32_t>(key - static_cast<uint32_t>(client_data->trace_target - 1)) < 0) {
+        return;  // 没越过采样位置的部分 send 也会带时间戳，忽略
+    }
+    int64_t tx_ns = static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+    g_trace_stats.write_to_tx.record(tx_ns - client_data->trace_write_ns);
+    client_data->trace_state = TraceState::Idle;
+}
+
+// 处理 socket 错误队列：零拷贝完成通知（归还内核已释放的块）和发送时间戳
+void handle_error_queue(ClientData* client_data) {
+    while (true) {
+        char control[256];
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(client_data->client_fd, &msg, MSG_ERRQUEUE) == -1) {
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "读取错误队列失败：" << std::strerror(errno) << std::endl;
+            }
+            return;  // 错误队列已读空
+        }
+
+        // 发送时间戳的消息里 SCM_TIMESTAMPING 排在 IP_RECVERR 前面
+        struct timespec tx_ts{};
+        for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr; cm = CMSG_NXTHDR(&msg, cm)) {
+            if (cm->cmsg_level == SOL_SOCKET && cm->cmsg_type == SCM_TIMESTAMPING) {
+                tx_ts = reinterpret_cast<struct scm_timestamping*>(CMSG_DATA(cm))->ts[0];
+                continue;
+            }
+            if (!(cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) &&
+                !(cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR)) {
+                continue;
+            }
+            auto* serr = reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+            if (serr->ee_origin == SO_EE_ORIGIN_TIMESTAMPING && serr->ee_info == SCM_TSTAMP_SND) {
+                handle_tx_timestamp(client_data, serr->ee_data, tx_ts);
+                continue;
+            }
+            if (serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr->ee_errno != 0) {
+                continue;
+            }
+
+            // [ee_info, ee_data] 是内核已完成的序号区间（闭区间，可能合并了多次发送）
+            uint32_t lo = serr->ee_info;
+            uint32_t hi = serr->ee_data;
+            g_stats.zc_completions += hi - lo + 1;
+            if (serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+                // 内核最终还是做了拷贝（比如回环网卡），继续零拷贝只会多付出钉页的代价，该连接退回拷贝路径
+                g_stats.zc_copied += hi - lo + 1;
+                client_data->zerocopy = false;
+            }
+            while (!client_data->zc_pending.empty() &&
+                   static_cast<int32_t>(client_data->zc_pending.front().seq - hi) <= 0) {
+                g_buffer_pool.release(client_data->zc_pending.front().block);
+                client_data->zc_pending.pop_front();
+            }
+        }
+    }
+}
+
+// 零拷贝发送全部完成（或已隔离）的关闭中连接：关闭 fd，本轮事件处理完后释放
+void finish_zerocopy_drain(ClientData* client_data, int epoll_fd) {
+    client_data->zc_draining = false;
+    std::erase(g_zc_draining, client_data);
+    epoll_remove(epoll_fd, client_data->client_fd);
+    g_closed_clients.push_back(client_data);
+}
+
+// 关闭中的连接收到错误队列事件：归还已完成的块，全部完成后真正关闭
+void drain_zerocopy(ClientData* client_data, int epoll_fd) {
+    handle_error_queue(client_data);
+    if (client_data->zc_pending.empty()) {
+        finish_zerocopy_drain(client_data, epoll_fd);
+    }
+}
+
+// 等完成通知超时的连接：剩下的块移进隔离列表（永不归还，内核可能还在读它们的页），然后关闭
+void expire_zerocopy_drains(int epoll_fd) {
+    for (size_t i = g_zc_draining.size(); i-- > 0;) {
+        ClientData* client_data = g_zc_draining[i];
+        if (g_now_ms < client_data->zc_drain_deadline_ms) {
+            continue;
+        }
+        handle_error_queue(client_data);
+        for (const ZeroCopyPending& pending : client_data->zc_pending) {
+            g_zc_quarantine.push_back(pending.block);
+        }
+        g_stats.zc_quarantined += client_data->zc_pending.size();
+        client_data->zc_pending.clear();
+        finish_zerocopy_drain(client_data, epoll_fd);
+    }
+}
+
+// 连接占用的缓冲块字节数（共享的块按整块计入每个引用者）
+size_t connection_memory(const ClientData* client_data) {
+    size_t bytes = 0;
+    for (const OutChunk& chunk : client_data->out_queue) {
+        bytes += chunk.block->capacity;
+    }
+    for (const ZeroCopyPending& pending : client_data->zc_pending) {
+        bytes += pending.block->capacity;
+    }
+    if (client_data->partial_message != nullptr) {
+        bytes += client_data->partial_message->capacity;
+    }
+    return bytes;
+}
+
+// 空闲连接：把缓冲块换成刚好装得下剩余数据的最小一级，读缓冲分级退回初始值，返回腾出的字节数
+// 被其他连接或零拷贝发送共享的块（refcnt > 1）不能搬
+size_t reclaim_idle_buffers(ClientData* client_data) {
+    size_t reclaimed = 0;
+    IoBlock*& partial = client_data->partial_message;
+    if (partial != nullptr && partial->size == 0) {
+        reclaimed += partial->capacity;
+        g_buffer_pool.release(partial);
+        partial = nullptr;
+    } else if (partial != nullptr && size_class_for(partial->size) < partial->size_class) {
+        reclaimed += partial->capacity;
+        partial = resize_block(partial, 0, partial->size);
+        reclaimed -= partial->capacity;
+    }
+    for (OutChunk& chunk : client_data->out_queue) {
+        size_t pending = chunk.block->size - chunk.offset;
+        if (chunk.block->refcnt == 1 && size_class_for(pending) < chunk.block->size_class) {
+            reclaimed += chunk.block->capacity;
+            chunk.block = resize_block(chunk.block, chunk.offset, pending);
+            chunk.offset = 0;
+            reclaimed -= chunk.block->capacity;
+        }
+    }
+    client_data->read_class = size_class_for(BUFFER_SIZE);
+    client_data->small_reads = 0;
+    return reclaimed;
+}
+
+// 本 reactor 上占用缓冲最多的连接（积压的数据也代表积压的工作），没有占用缓冲的连接时返回 nullptr
+// shed 类策略每个定时器周期最多断开一个，避免一次性断开一片
+ClientData* heaviest_connection() {
+    ClientData* heaviest = nullptr;
+    size_t heaviest_bytes = 0;
+    for (ClientData* client_data : g_connections) {
+        size_t bytes = connection_memory(client_data);
+        if (bytes > heaviest_bytes) {
+            heaviest = client_data;
+            heaviest_bytes = bytes;
+        }
+    }
+    return heaviest;
+}
+
+// 单调时钟（微秒），vDSO 实现，不进内核
+uint64_t monotonic_us() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+}
+
+// 一轮事件处理结束：记录这一轮的耗时
+void record_iteration(uint64_t wake_us) {
+    LoopMonitor& monitor = g_loop_monitor;
+    uint64_t busy_us = monotonic_us() - wake_us;
+    ++monitor.iterations;
+    monitor.busy_max_us = std::max(monitor.busy_max_us, busy_us);
+    monitor.window_max_us = std::max(monitor.window_max_us, busy_us);
+    int64_t delta = static_cast<int64_t>(busy_us) - static_cast<int64_t>(monitor.busy_ewma_us);
+    monitor.busy_ewma_us += delta / 8;
+}
+
+// 过载判定（每个定时器周期一次）：周期内最慢的一轮或定时器漂移超过阈值记为落后，
+// 连续 OVERLOAD_ENTER_TICKS 个周期落后进入过载，进入后连续 OVERLOAD_EXIT_TICKS 个周期低于阈值一半才恢复
+void update_overload_state(uint64_t drift_us, const LoopFds& fds, int epoll_fd) {
+    LoopMonitor& monitor = g_loop_monitor;
+    uint64_t lag_us = std::max(monitor.window_max_us, drift_us);
+    monitor.window_max_us = 0;
+    if (!monitor.overloaded) {
+        monitor.hot_ticks = lag_us > g_config.lag_threshold_us ? monitor.hot_ticks + 1 : 0;
+        if (monitor.hot_ticks >= OVERLOAD_ENTER_TICKS) {
+            monitor.overloaded = true;
+            monitor.cool_ticks = 0;
+            ++g_stats.overload_entered;
+            std::cout << "事件循环持续落后（延迟 " << lag_us << " us），进入过载保护" << std::endl;
+        }
+    } else {
+        monitor.cool_ticks = lag_us < g_config.lag_threshold_us / 2 ? monitor.cool_ticks + 1 : 0;
+        if (monitor.cool_ticks >= OVERLOAD_EXIT_TICKS) {
+            monitor.overloaded = false;
+            monitor.hot_ticks = 0;
+            std::cout << "事件循环延迟恢复正常，退出过载保护" << std::endl;
+        }
+    }
+    if (t_reactor != nullptr) {
+        t_reactor->overloaded.store(monitor.overloaded, std::memory_order_relaxed);
+    }
+
+    if (monitor.overloaded && g_config.overload_policy == OverloadPolicy::Shed) {
+        ClientData* heaviest = heaviest_connection();
+        if (heaviest != nullptr) {
+            ++g_stats.overload_shed;
+            print_client_info(heaviest, "事件循环过载，断开积压最多的连接");
+            close_client(heaviest, epoll_fd);
+        }
+    }
+    // 恢复 accept：backlog 里等着的连接不会再触发边沿事件，这里主动接收一次
+    if (monitor.accept_paused && !admission_closed()) {
+        monitor.accept_paused = false;
+        handle_new_connection(fds.server_fd, ConnType::Client, epoll_fd);
+        if (fds.unix_fd != -1) {
+            handle_new_connection(fds.unix_fd, ConnType::Client, epoll_fd);
+        }
+        if (fds.shm_fd != -1) {
+            handle_new_connection(fds.shm_fd, ConnType::ShmControl, epoll_fd);
+        }
+    }
+}
+
+// 定时器：测量定时器漂移并更新过载状态，恢复限速暂停的连接，空闲连接回收缓冲、空闲链表归还系统、检查全局内存预算
+void handle_timer_event(const LoopFds& fds, int epoll_fd) {
+    uint64_t expirations;
+    ssize_t ret = read(fds.timer_fd, &expirations, sizeof(expirations));
+    (void)ret;
+
+    uint64_t now_us = monotonic_us();
+    uint64_t drift_us = 0;
+    if (g_loop_monitor.last_tick_us != 0 && now_us - g_loop_monitor.last_tick_us > TICK_INTERVAL_MS * 1000) {
+        drift_us = now_us - g_loop_monitor.last_tick_us - TICK_INTERVAL_MS * 1000;
+    }
+    g_loop_monitor.last_tick_us = now_us;
+    g_loop_monitor.drift_max_us = std::max(g_loop_monitor.drift_max_us, drift_us);
+    update_overload_state(drift_us, fds, epoll_fd);
+
+    for (ClientData* client_data : g_connections) {
+        // 限速：令牌补足后重新打开读
+        if (client_data->rate_paused && rate_allowance(client_data) > 0) {
+            client_data->rate_paused = false;
+            update_events(client_data, epoll_fd);
+        }
+        if (g_now_ms - client_data->last_active_ms >= IDLE_RECLAIM_MS) {
+            g_stats.reclaimed_bytes += reclaim_idle_buffers(client_data);
+        }
+    }
+    if (g_config.ip_rate_limited() && g_now_ms - g_ip_sweep_ms >= IP_SWEEP_INTERVAL_MS) {
+        g_ip_sweep_ms = g_now_ms;
+        sweep_ip_rates();
+    }
+    if (!g_zc_draining.empty()) {
+        expire_zerocopy_drains(epoll_fd);
+    }
+    // 只有处理客户端的 reactor 需要后端连接池（主/从模式下的 acceptor 不需要）
+    if (g_config.mode == ServerMode::Proxy && (g_config.reactors == 0 || t_reactor != nullptr) &&
+        g_now_ms - g_pool_refill_ms >= BACKEND_POOL_REFILL_MS) {
+        g_pool_refill_ms = g_now_ms;
+        refill_upstream_pool(epoll_fd);
+    }
+
+    // 超出预算时空闲链表全部还给系统，否则只保留一部分供突发流量复用
+    g_stats.trimmed_bytes += g_buffer_pool.trim(g_memory_budget.exceeded() ? 0 : POOL_KEEP_BYTES);
+    if (g_memory_budget.exceeded()) {
+        ClientData* heaviest = g_config.memory_policy == MemoryPolicy::Shed ? heaviest_connection() : nullptr;
+        if (heaviest != nullptr) {
+            ++g_stats.memory_sheds;
+            print_client_info(heaviest, "超出内存预算，断开占用最多的连接");
+            close_client(heaviest, epoll_fd);
+            g_stats.trimmed_bytes += g_buffer_pool.trim(0);
+        }
+        return;
+    }
+
+    // 预算恢复：重新打开因内存暂停的读（EPOLLIN 重新注册时，已有数据的 socket 会立即再次就绪）
+    for (ClientData* client_data : g_connections) {
+        if (client_data->memory_paused) {
+            client_data->memory_paused = false;
+            update_events(client_data, epoll_fd);
+        }
+    }
+}
+
+// 页类型的名字（与 --arena-pages 的取值一致）
+const char* arena_pages_name(ArenaPages pages) {
+    switch (pages) {
+        case ArenaPages::HugeTlb: return "hugetlb";
+        case ArenaPages::Transparent: return "thp";
+        case ArenaPages::Regular: return "none";
+        default: return "auto";
+    }
+}
+
+// 打印服务器统计信息
+// 先拼成一整段再输出，多个 reactor 同时打印时不会交错
+void print_stats() {
+    std::ostringstream out;
+    out << "========== 服务器统计";
+    if (t_reactor != nullptr) {
+        out << "（reactor #" << t_reactor->index << "，连接数 "
+            << t_reactor->connections.load(std::memory_order_relaxed) << "）";
+    }
+    out << " ==========\n"
+        << "连接：接受 " << g_stats.accepted << "，关闭 " << g_stats.closed << "\n"
+        << "字节：读取 " << g_stats.bytes_read << "，发送 " << g_stats.bytes_written << "\n"
+        << "零拷贝：发送 " << g_stats.zc_sends << " 次 / " << g_stats.zc_bytes << " 字节"
+        << "，完成 " << g_stats.zc_completions
+        << "，内核拷贝 " << g_stats.zc_copied
+        << "，ENOBUFS 回退 " << g_stats.zc_fallbacks
+        << "，关闭时等待完成 " << g_stats.zc_drains << " 个连接"
+        << "，超时隔离 " << g_stats.zc_quarantined << " 块\n"
+        << "背压：暂停读 " << g_stats.read_pauses << " 次\n"
+        << "后端连接：新建 " << g_stats.upstream_connects
+        << "，取自预连接池 " << g_stats.upstream_pooled
+        << "，池中空闲 " << g_idle_upstreams.size() << "\n"
+        << "房间：成员 " << (g_config.mode == ServerMode::Room ? g_connections.size() : 0)
+        << "，消息 " << g_stats.room_messages
+        << "，投递 " << g_stats.room_deliveries
+        << "，跳过 " << g_stats.room_lagged
+        << "，断开慢订阅者 " << g_stats.room_dropped << "\n"
+        << "offload：提交 " << g_stats.offload_submitted
+        << "，完成 " << g_stats.offload_completed
+        << "，reactor 直接处理 " << g_stats.offload_inline << "\n"
+        << "内存：全局已申请 " << g_memory_budget.reserved.load(std::memory_order_relaxed)
+        << " 字节，使用中 " << g_memory_budget.in_use.load(std::memory_order_relaxed)
+        << "，预算 ";
+    if (g_memory_budget.limit != 0) {
+        out << g_memory_budget.limit;
+    } else {
+        out << "不限";
+    }
+    out << "\n"
+        << "缓冲池：已申请 " << g_buffer_pool.get_reserved_bytes()
+        << " 字节，使用中 " << g_buffer_pool.get_in_use_bytes()
+        << "，空闲 " << g_buffer_pool.get_free_bytes()
+        << "（块：已分配 " << g_buffer_pool.get_total_blocks()
+        << "，使用中 " << g_buffer_pool.get_pinned_blocks() << "，空闲";
+    for (uint8_t i = 0; i < SIZE_CLASS_COUNT; ++i) {
+        out << " " << SIZE_CLASSES[i] / 1024 << "K×" << g_buffer_pool.get_free_count(i);
+    }
+    out << "）\n";
+    if (g_block_arena.enabled()) {
+        out << "arena：" << arena_pages_name(g_block_arena.get_pages())
+            << (g_block_arena.is_locked() ? "（mlock）" : "")
+            << "，空闲 slab " << g_block_arena.get_free_slabs() << " / " << g_block_arena.get_slab_count() << "\n";
+    }
+    out << "内存回收：空闲连接腾出 " << g_stats.reclaimed_bytes
+        << " 字节，归还系统 " << g_stats.trimmed_bytes
+        << " 字节，超预算暂停读 " << g_stats.memory_pauses
+        << " 次，断开 " << g_stats.memory_sheds << "\n"
+        << "事件循环：迭代 " << g_loop_monitor.iterations
+        << "，单轮耗时 平均 " << g_loop_monitor.busy_ewma_us
+        << " us / 最大 " << g_loop_monitor.busy_max_us
+        << " us，批内排队最大 " << g_loop_monitor.queue_max_us
+        << " us，定时器漂移最大 " << g_loop_monitor.drift_max_us << " us（最大值自上次打印起）\n"
+        << "过载保护：" << (g_loop_monitor.overloaded ? "过载中" : "正常")
+        << "，进入 " << g_stats.overload_entered
+        << " 次，RST 拒绝 " << g_stats.overload_rejected
+        << "，暂停 accept " << g_stats.accept_pauses
+        << " 次，断开 " << g_stats.overload_shed << "\n"
+        << "限速：令牌不足暂停读 " << g_stats.rate_throttles
+        << " 次，IP 表条目 " << g_ip_rates.size() << " / " << g_ip_rates.capacity() << "\n";
+    if (g_config.timestamp_sample != 0) {
+        auto print_stage = [&out](const char* name, const LatencyHistogram& histogram) {
+            out << "  " << name << "：样本 " << histogram.count()
+                << "，平均 " << histogram.mean() / 1000.0
+                << " us，p50 " << histogram.percentile(0.5) / 1000.0
+                << " us，p90 " << histogram.percentile(0.9) / 1000.0
+                << " us，p99 " << histogram.percentile(0.99) / 1000.0
+                << " us，max " << histogram.max() / 1000.0 << " us\n";
+        };
+        out << "时间戳追踪：每 " << g_config.timestamp_sample << " 次读采样一次，已采样 " << g_trace_stats.sampled
+            << "，未完成 " << g_trace_stats.abandoned << "\n";
+        print_stage("到达 → read ", g_trace_stats.rx_to_read);
+        print_stage("read → send ", g_trace_stats.read_to_write);
+        print_stage("send → 驱动 ", g_trace_stats.write_to_tx);
+    }
+    if (!g_config.shm_path.empty()) {
+        out << "共享内存传输：会话 " << g_stats.shm_sessions
+            << "，回声 " << g_stats.shm_bytes
+            << " 字节，被叫醒 " << g_stats.shm_wakeups
+            << " 次，叫醒客户端 " << g_stats.shm_signals << " 次\n";
+    }
+    if (g_capture_log.enabled()) {
+        out << "流量抓取：记录 " << g_capture_log.get_records()
+            << " 条，已用 " << g_capture_log.get_used_bytes() << " / " << g_capture_log.get_capacity()
+            << " 字节，写满丢弃 " << g_capture_log.get_dropped() << " 条\n";
+    }
+    g_loop_monitor.busy_max_us = 0;
+    g_loop_monitor.queue_max_us = 0;
+    g_loop_monitor.drift_max_us = 0;
+    if (!g_sub_reactors.empty() && t_reactor == nullptr) {
+        out << "acceptor：分发 " << g_stats.dispatched << "，拒绝 " << g_stats.rejected << "\n";
+    }
+    out << "================================\n";
+    std::cout << out.str() << std::flush;
+}
+
+// 处理信号（通过 signalfd 在主循环里同步处理）：SIGUSR1 打印统计信息
+void handle_signal_event(int signal_fd) {
+    struct signalfd_siginfo info;
+    while (read(signal_fd, &info, sizeof(info)) == sizeof(info)) {
+        if (info.ssi_signo == SIGUSR1) {
+            print_stats();
+            // 主/从模式：通知每个从 reactor 打印自己的统计（各自的计数只由各自的线程读写）
+            g_stats_generation.fetch_add(1, std::memory_order_release);
+            for (auto& reactor : g_sub_reactors) {
+                uint64_t one = 1;
+                ssize_t ret = write(reactor->wake_fd, &one, sizeof(one));
+                (void)ret;
+            }
+        }
+    }
+}
+
+// 创建周期触发的 timerfd（由 epoll 统一派发）
+int init_timer_fd(int interval_ms) {
+    int timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "timerfd 创建失败");
+    }
+    struct itimerspec spec{};
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000L;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(timer_fd, 0, &spec, nullptr) == -1) {
+        throw std::system_error(errno, std::generic_category(), "timerfd 设置失败");
+    }
+    return timer_fd;
+}
+
+// 创建 signalfd（先屏蔽信号，改由 epoll 统一派发）
+int init_signal_fd() {
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGUSR1);
+    if (sigprocmask(SIG_BLOCK, &mask, nullptr) == -1) {
+        throw std::system_error(errno, std::generic_category(), "sigprocmask 失败");
+    }
+    int signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "signalfd 创建失败");
+    }
+    return signal_fd;
+}
+
+// 初始化服务器 socket
+// 指定了 --listen-fd 时直接使用继承来的监听 socket（已经 bind/listen 过）
+int init_server_socket() {
+    if (g_config.listen_fd >= 0) {
+        set_non_blocking(g_config.listen_fd);
+        std::cout << "使用继承的监听 socket，FD：" << g_config.listen_fd << std::endl;
+        return g_config.listen_fd;
+    }
+
+    // 创建 socket（TCP 协议）
+    int server_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (server_fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "创建 socket 失败");
+    }
+
+    // 设置端口复用（避免服务器重启时端口被占用）以及 socket 配置中的监听选项
+    apply_listener_options(server_fd, g_config.socket_profile);
+
+    // 绑定端口和 IP
+    struct sockaddr_in server_addr;
+    memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;         // IPv4
+    server_addr.sin_addr.s_addr = INADDR_ANY; // 监听所有网卡 IP
+    server_addr.sin_port = htons(g_config.port);  // 端口转换为网络字节序
+
+    if (bind(server_fd, (struct sockaddr*)&server_addr, sizeof(server_addr)) == -1) {
+        throw std::system_error(errno, std::generic_category(), "bind 端口失败");
+    }
+
+    // 开始监听（backlog=128 表示等待队列最大长度）
+    if (listen(server_fd, 128) == -1) {
+        throw std::system_error(errno, std::generic_category(), "listen 失败");
+    }
+
+    // 设置服务器 FD 为非阻塞（配合 epoll ET 模式）
+    set_non_blocking(server_fd);
+
+    std::cout << "服务器初始化成功，监听端口：" << g_config.port << std::endl;
+    return server_fd;
+}
+
+// 创建 Unix 域监听 socket（--unix / --shm），先删掉上次运行留下的 socket 文件
+int init_unix_socket(const std::string& path) {
+    struct sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("Unix socket 路径过长：" + path);
+    }
+    memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listen_fd == -1) {
+        throw std::system_error(errno, std::generic_category(), "创建 Unix socket 失败");
+    }
+    unlink(path.c_str());
+    if (bind(listen_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+        throw std::system_error(errno, std::generic_category(), "bind Unix socket 失败：" + path);
+    }
+    if (listen(listen_fd, 128) == -1) {
+        throw std::system_error(errno, std::generic_category(), "listen Unix socket 失败");
+    }
+    std::cout << "监听 Unix socket：" << path << std::endl;
+    return listen_fd;
+}
+
+constexpr const char* USAGE =
+    "用法：server [--port=端口] [--listen-fd=FD] [--reactors=线程数] [--dispatch=rr|least]\n"
+    "             [--mode=echo|proxy|room|offload] [--backend=IP:端口] [--backend-pool=连接数]\n"
+    "             [--slow-policy=drop|lag] [--room-max-lag=字节数] [--workers=线程数] [--quiet]\n"
+    "             [--zerocopy] [--zerocopy-threshold=字节数] [--memory-budget=字节数] [--memory-policy=pause|shed]\n"
+    "             [--arena=字节数] [--arena-pages=auto|hugetlb|thp|none] [--arena-mlock]\n"
+    "             [--lag-threshold=毫秒] [--overload-policy=none|pause-accept|reject|shed]\n"
+    "             [--rate-bytes=字节/秒] [--rate-msgs=行/秒] [--ip-rate-bytes=字节/秒] [--ip-rate-msgs=行/秒]\n"
+    "             [--timestamping[=采样间隔]] [--capture=文件] [--capture-size=字节数] [--capture-payload[=字节数]]\n"
+    "             [--unix=socket 路径] [--shm=握手 socket 路径]（共享内存传输只做回声）\n"
+    "             [--socket-profile=none|latency|throughput] [--tcp-nodelay=0|1] [--tcp-cork=0|1]\n"
+    "             [--keepalive=0|1] [--sndbuf=字节数] [--rcvbuf=字节数]\n"
+    "             [--tcp-defer-accept=秒] [--tcp-fastopen=队列长度]";
+
+// 预留缓冲块 arena（必须在任何线程取块之前），要求的页类型不可用时提示实际退到了哪一种
+void init_block_arena() {
+    if (g_config.arena_bytes == 0) {
+        return;
+    }
+    ArenaPages pages = g_block_arena.init(g_config.arena_bytes, g_config.arena_pages, g_config.arena_mlock);
+    if (g_config.arena_pages != ArenaPages::Auto && pages != g_config.arena_pages) {
+        std::cerr << "arena 无法使用 " << arena_pages_name(g_config.arena_pages) << " 页，已退回 "
+                  << arena_pages_name(pages) << std::endl;
+    }
+    if (g_config.arena_mlock && !g_block_arena.is_locked()) {
+        std::cerr << "mlock arena 失败（检查 ulimit -l）：" << std::strerror(errno) << std::endl;
+    }
+    std::cout << "缓冲块 arena：" << g_block_arena.get_slab_count() << " 个 " << SLAB_SIZE / 1024
+              << "K slab，页类型 " << arena_pages_name(pages) << (g_block_arena.is_locked() ? "，已 mlock" : "")
+              << std::endl;
+}
+
+// 解析 IP:端口 形式的地址
+struct sockaddr_in parse_address(std::string_view text) {
+    size_t colon = text.rfind(':');
+    if (colon == std::string_view::npos) {
+        throw std::invalid_argument("地址格式应为 IP:端口：" + std::string(text));
+    }
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(std::stoi(std::string(text.substr(colon + 1))));
+    if (inet_pton(AF_INET, std::string(text.substr(0, colon)).c_str(), &addr.sin_addr) != 1) {
+        throw std::invalid_argument("无效的 IP 地址：" + std::string(text));
+    }
+    return addr;
+}
+
+// 解析命令行参数（--key=value 形式），参数错误时抛出 std::invalid_argument
+void parse_args(int argc, char* argv[]) {
+    bool has_backend = false;
+    for (int i = 1; i < argc; ++i) {
+        std::string_view arg = argv[i];
+        std::string value(arg.substr(arg.find('=') + 1));
+        if (arg.starts_with("--port=")) {
+            g_config.port = static_cast<uint16_t>(std::stoi(value));
+        } else if (arg.starts_with("--listen-fd=")) {
+            g_config.listen_fd = std::stoi(value);
+        } else if (arg.starts_with("--reactors=")) {
+            g_config.reactors = std::stoul(value);
+        } else if (arg == "--dispatch=rr") {
+            g_config.dispatch = DispatchPolicy::RoundRobin;
+        } else if (arg == "--dispatch=least") {
+            g_config.dispatch = DispatchPolicy::LeastLoad;
+        } else if (arg == "--mode=echo") {
+            g_config.mode = ServerMode::Echo;
+        } else if (arg == "--mode=proxy") {
+            g_config.mode = ServerMode::Proxy;
+        } else if (arg == "--mode=room") {
+            g_config.mode = ServerMode::Room;
+        } else if (arg == "--mode=offload") {
+            g_config.mode = ServerMode::Offload;
+        } else if (arg.starts_with("--workers=")) {
+            g_config.workers = std::max<size_t>(1, std::stoul(value));
+        } else if (arg == "--slow-policy=drop") {
+            g_config.slow_policy = SlowPolicy::Drop;
+        } else if (arg == "--slow-policy=lag") {
+            g_config.slow_policy = SlowPolicy::Lag;
+        } else if (arg.starts_with("--room-max-lag=")) {
+            g_config.room_max_lag = std::stoul(value);
+        } else if (arg == "--quiet") {
+            g_config.verbose = false;
+        } else if (arg.starts_with("--backend=")) {
+            g_config.backend_addr = parse_address(value);
+            has_backend = true;
+        } else if (arg.starts_with("--backend-pool=")) {
+            g_config.backend_pool_size = std::stoul(value);
+        } else if (arg == "--zerocopy") {
+            g_config.zerocopy = true;
+        } else if (arg.starts_with("--zerocopy-threshold=")) {
+            g_config.zerocopy_threshold = std::stoul(value);
+        } else if (arg.starts_with("--memory-budget=")) {
+            g_config.memory_budget = std::stoul(value);
+        } else if (arg.starts_with("--arena=")) {
+            g_config.arena_bytes = std::stoul(value);
+        } else if (arg == "--arena-pages=auto") {
+            g_config.arena_pages = ArenaPages::Auto;
+        } else if (arg == "--arena-pages=hugetlb") {
+            g_config.arena_pages = ArenaPages::HugeTlb;
+        } else if (arg == "--arena-pages=thp") {
+            g_config.arena_pages = ArenaPages::Transparent;
+        } else if (arg == "--arena-pages=none") {
+            g_config.arena_pages = ArenaPages::Regular;
+        } else if (arg == "--arena-mlock") {
+            g_config.arena_mlock = true;
+        } else if (arg == "--memory-policy=pause") {
+            g_config.memory_policy = MemoryPolicy::Pause;
+        } else if (arg == "--memory-policy=shed") {
+            g_config.memory_policy = MemoryPolicy::Shed;
+        } else if (arg.starts_with("--lag-threshold=")) {
+            g_config.lag_threshold_us = std::stoul(value) * 1000;
+        } else if (arg == "--overload-policy=none") {
+            g_config.overload_policy = OverloadPolicy::None;
+        } else if (arg == "--overload-policy=pause-accept") {
+            g_config.overload_policy = OverloadPolicy::PauseAccept;
+        } else if (arg == "--overload-policy=reject") {
+            g_config.overload_policy = OverloadPolicy::Reject;
+        } else if (arg == "--overload-policy=shed") {
+            g_config.overload_policy = OverloadPolicy::Shed;
+        } else if (arg.starts_with("--rate-bytes=")) {
+            g_config.rate_bytes = std::stoll(value);
+        } else if (arg.starts_with("--rate-msgs=")) {
+            g_config.rate_messages = std::stoll(value);
+        } else if (arg.starts_with("--ip-rate-bytes=")) {
+            g_config.ip_rate_bytes = std::stoll(value);
+        } else if (arg.starts_with("--ip-rate-msgs=")) {
+            g_config.ip_rate_messages = std::stoll(value);
+        } else if (arg.starts_with("--capture=")) {
+            g_config.capture_path = value;
+        } else if (arg.starts_with("--capture-size=")) {
+            g_config.capture_size = std::max<size_t>(4096, std::stoul(value));
+        } else if (arg == "--capture-payload") {
+            g_config.capture_payload = CAPTURE_PAYLOAD;
+        } else if (arg.starts_with("--capture-payload=")) {
+            g_config.capture_payload = std::stoul(value);
+        } else if (arg == "--timestamping") {
+            g_config.timestamp_sample = TIMESTAMP_SAMPLE;
+        } else if (arg.starts_with("--timestamping=")) {
+            g_config.timestamp_sample = std::max<size_t>(1, std::stoul(value));
+        } else if (arg.starts_with("--unix=")) {
+            g_config.unix_path = value;
+        } else if (arg.starts_with("--shm=")) {
+            g_config.shm_path = value;
+        } else if (parse_socket_option(arg, g_config.socket_profile)) {
+            continue;
+        } else {
+            throw std::invalid_argument("未知参数：" + std::string(arg) + "\n" + USAGE);
+        }
+    }
+    if (g_config.mode == ServerMode::Proxy && !has_backend) {
+        throw std::invalid_argument(std::string("代理模式需要指定 --backend\n") + USAGE);
+    }
+    // 房间成员表属于单个 reactor，广播不跨线程
+    if (g_config.mode == ServerMode::Room && g_config.reactors > 0) {
+        throw std::invalid_argument("房间模式只支持单 reactor（不能和 --reactors 同时使用）");
+    }
+}
+
+// 注册一个只关注读事件的内部 fd（监听 socket、signalfd、eventfd），返回绑定的占位数据
+std::unique_ptr<ClientData> watch_fd(int epoll_fd, int fd) {
+    auto placeholder = std::make_unique<ClientData>();
+    placeholder->client_fd = fd;
+    epoll_add_or_modify(epoll_fd, fd, EPOLLIN | EPOLLET, placeholder.get());
+    return placeholder;
+}
+
+// offload 模式：为当前 reactor 启动 worker 线程池，返回结果通知的 eventfd
+int start_offload_pool() {
+    g_worker_pool = std::make_unique<WorkerPool>(g_config.workers, OFFLOAD_QUEUE_CAPACITY, process_request);
+    std::cout << "offload 模式，worker 线程数：" << g_config.workers << std::endl;
+    return g_worker_pool->get_notify_fd();
+}
+
+// 从 reactor：取出 acceptor 送来的新连接，顺便响应打印统计的请求
+void handle_reactor_inbox(SubReactor* reactor, int epoll_fd) {
+    uint64_t count;
+    ssize_t ret = read(reactor->wake_fd, &count, sizeof(count));
+    (void)ret;
+
+    AcceptedConnection conn;
+    while (reactor->inbox.pop(conn)) {
+        adopt_connection(conn.fd, conn.addr, conn.type, epoll_fd);
+    }
+
+    uint64_t generation = g_stats_generation.load(std::memory_order_acquire);
+    if (generation != reactor->stats_generation_seen) {
+        reactor->stats_generation_seen = generation;
+        print_stats();
+    }
+}
+
+// 事件循环（单 reactor、acceptor、从 reactor 共用）
+void run_event_loop(int epoll_fd, const LoopFds& fds) {
+    struct epoll_event events[MAX_EVENTS];  // 存储就绪事件的数组
+    while (true) {
+        // 阻塞等待事件触发（EPOLL_TIMEOUT=-1 无限阻塞）
+        USDT_PROBE1(epoll_wait_enter, epoll_fd);
+        int ready_events = epoll_wait(epoll_fd, events, MAX_EVENTS, EPOLL_TIMEOUT);
+        USDT_PROBE2(epoll_wait_exit, epoll_fd, ready_events);
+        if (ready_events == -1) {
+            if (errno == EINTR) {  // EINTR：被信号中断（比如 Ctrl+C），忽略继续循环
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "epoll_wait 失败");
+        }
+        uint64_t wake_us = monotonic_us();
+        g_now_ms = wake_us / 1000;
+
+        // 遍历所有就绪事件
+        for (int i = 0; i < ready_events; ++i) {
+            if (i > 0 && i == ready_events - 1) {
+                // 最后一个事件排队最久：记录批内排队延迟
+                g_loop_monitor.queue_max_us = std::max(g_loop_monitor.queue_max_us, monotonic_us() - wake_us);
+            }
+            ClientData* data = static_cast<ClientData*>(events[i].data.ptr);
+            if (data->closed) {
+                if (data->zc_draining && (events[i].events & EPOLLERR)) {
+                    drain_zerocopy(data, epoll_fd);  // 已关闭、在等零拷贝完成通知的连接
+                }
+                continue;  // 本轮处理前面的事件时已被关闭（比如代理模式下对端断开）
+            }
+            int fd = data->client_fd;
+
+            // 事件类型判断
+            if (fd == fds.server_fd || fd == fds.unix_fd) {
+                // 监听 socket 的读事件：新客户端连接
+                handle_new_connection(fd, ConnType::Client, epoll_fd);
+            } else if (fd == fds.shm_fd) {
+                // 共享内存握手的监听 socket：新的共享内存客户端
+                handle_new_connection(fd, ConnType::ShmControl, epoll_fd);
+            } else if (fd == fds.signal_fd) {
+                // signalfd 的读事件：收到信号
+                handle_signal_event(fds.signal_fd);
+            } else if (fd == fds.offload_fd) {
+                // worker 送回了处理结果
+                handle_offload_results(epoll_fd);
+            } else if (fd == fds.inbox_fd) {
+                // acceptor 送来了新连接
+                handle_reactor_inbox(t_reactor, epoll_fd);
+            } else if (fd == fds.timer_fd) {
+                // 周期定时器：过载判定、空闲回收和内存预算检查
+                handle_timer_event(fds, epoll_fd);
+            } else if (data->type == ConnType::ShmControl) {
+                // 共享内存会话的控制连接：握手或客户端断开
+                handle_shm_control_event(data, epoll_fd);
+            } else if (data->type == ConnType::ShmNotify) {
+                // 共享内存会话：客户端叫醒服务器
+                handle_shm_notify_event(data->peer);
+            } else {
+                if ((events[i].events & EPOLLERR) &&
+                    (!data->zc_pending.empty() || data->trace_state == TraceState::WaitTx)) {
+                    // 错误队列里有零拷贝完成通知或发送时间戳
+                    handle_error_queue(data);
+                }
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    // 客户端 FD 的读事件：客户端发数据（挂断/出错也由 read 的返回值处理）
+                    bool alive;
+                    switch (g_config.mode) {
+                        case ServerMode::Room:
+                            alive = handle_line_read_event(data, epoll_fd, publish_to_room);
+                            break;
+                        case ServerMode::Offload:
+                            alive = handle_line_read_event(data, epoll_fd, submit_lines);
+                            break;
+                        default:
+                            alive = handle_read_event(data, epoll_fd);
+                            break;
+                    }
+                    if (!alive) {
+                        continue;  // 连接已关闭，data 已释放
+                    }
+                }
+                if (events[i].events & EPOLLOUT) {
+                    // 客户端 FD 的写事件：可以向客户端发数据
+                    handle_write_event(data, epoll_fd);
+                }
+            }
+        }
+
+        // 本轮事件处理完毕，释放已关闭的连接
+        for (ClientData* closed_data : g_closed_clients) {
+            if (closed_data->offload_inflight > 0) {
+                closed_data->offload_detached = true;  // 还有请求在 worker 手里，交给 handle_offload_results 释放
+            } else {
+                delete closed_data;
+            }
+        }
+        g_closed_clients.clear();
+        record_iteration(wake_us);
+    }
+}
+
+// 从 reactor 线程入口
+void run_sub_reactor(SubReactor* reactor) {
+    t_reactor = reactor;
+    try {
+        int epoll_fd = epoll_create1(0);
+        if (epoll_fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "epoll_create1 失败");
+        }
+        LoopFds fds;
+        fds.inbox_fd = reactor->wake_fd;
+        auto inbox_data = watch_fd(epoll_fd, fds.inbox_fd);
+        fds.timer_fd = init_timer_fd(TICK_INTERVAL_MS);
+        auto timer_data = watch_fd(epoll_fd, fds.timer_fd);
+        std::unique_ptr<ClientData> offload_data;
+        if (g_config.mode == ServerMode::Offload) {
+            fds.offload_fd = start_offload_pool();
+            offload_data = watch_fd(epoll_fd, fds.offload_fd);
+        }
+        run_event_loop(epoll_fd, fds);
+    } catch (const std::exception& e) {
+        std::cerr << "reactor #" << reactor->index << " 异常退出：" << e.what() << std::endl;
+        std::exit(1);
+    }
+}
+
+// 主/从模式：启动从 reactor 线程（调用前信号已屏蔽，新线程继承屏蔽字，信号只由 acceptor 的 signalfd 处理）
+void start_sub_reactors() {
+    for (size_t i = 0; i < g_config.reactors; ++i) {
+        auto reactor = std::make_unique<SubReactor>(i);
+        reactor->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (reactor->wake_fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "eventfd 创建失败");
+        }
+        g_sub_reactors.push_back(std::move(reactor));
+    }
+    // 所有从 reactor 都放进 g_sub_reactors 之后再启动线程，启动后该数组不再修改
+    for (auto& reactor : g_sub_reactors) {
+        reactor->thread = std::thread(run_sub_reactor, reactor.get());
+        reactor->thread.detach();
+    }
+    std::cout << "主/从 reactor 模式，从 reactor 数：" << g_config.reactors
+              << "，分发策略：" << (g_config.dispatch == DispatchPolicy::LeastLoad ? "最少连接" : "轮询") << std::endl;
+}
+
+// 微基准把整个文件包含进去，只用其中的事件处理函数
+#ifndef ECHO_SERVER_NO_MAIN
+int main(int argc, char* argv[]) {
+    try {
+        parse_args(argc, argv);
+        print_socket_profile(g_config.socket_profile);
+        init_block_arena();
+        if (!g_config.capture_path.empty()) {
+            g_capture_log.open(g_config.capture_path, g_config.capture_size,
+                               static_cast<uint32_t>(g_config.capture_payload));
+            std::cout << "抓取流量到 " << g_config.capture_path << "（最多 " << g_config.capture_size
+                      << " 字节，每次读保存 " << g_config.capture_payload << " 字节数据）" << std::endl;
+        }
+
+        // 1. 初始化服务器 socket
+        int server_fd = init_server_socket();
+
+        // 2. 创建 epoll 实例（参数大于 0 即可，现代 Linux 忽略该参数）
+        int epoll_fd = epoll_create1(0);
+        if (epoll_fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "epoll_create1 失败");
+        }
+
+        // 3. 向 epoll 注册服务器 FD 的读事件（监听新连接，ET 模式）和 signalfd（kill -USR1 <pid> 打印统计信息）
+        LoopFds fds;
+        fds.server_fd = server_fd;
+        fds.signal_fd = init_signal_fd();
+        auto server_data = watch_fd(epoll_fd, fds.server_fd);
+        auto signal_data = watch_fd(epoll_fd, fds.signal_fd);
+
+        // 本机调用方：Unix 域 socket（和 TCP 走同一套处理）、共享内存传输的握手 socket
+        std::unique_ptr<ClientData> unix_data;
+        std::unique_ptr<ClientData> shm_data;
+        if (!g_config.unix_path.empty()) {
+            fds.unix_fd = init_unix_socket(g_config.unix_path);
+            unix_data = watch_fd(epoll_fd, fds.unix_fd);
+        }
+        if (!g_config.shm_path.empty()) {
+            fds.shm_fd = init_unix_socket(g_config.shm_path);
+            shm_data = watch_fd(epoll_fd, fds.shm_fd);
+        }
+
+        // 定时器：acceptor 用它在从 reactor 恢复后重新开始 accept，单 reactor 还用它做空闲回收
+        fds.timer_fd = init_timer_fd(TICK_INTERVAL_MS);
+        auto timer_data = watch_fd(epoll_fd, fds.timer_fd);
+
+        // 主/从模式：当前线程只做 acceptor，连接交给从 reactor；单 reactor 时 offload 线程池挂在当前线程
+        g_memory_budget.limit = g_config.memory_budget;
+        std::unique_ptr<ClientData> offload_data;
+        if (g_config.reactors > 0) {
+            start_sub_reactors();
+        } else if (g_config.mode == ServerMode::Offload) {
+            fds.offload_fd = start_offload_pool();
+            offload_data = watch_fd(epoll_fd, fds.offload_fd);
+        }
+
+        // 4. 循环等待 epoll 事件（服务器主循环，正常情况下不会返回）
+        run_event_loop(epoll_fd, fds);
 
         // 5. 资源释放（实际不会执行，因为主循环是无限的）
+        close(fds.signal_fd);
         close(epoll_fd);
         close(server_fd);
 
@@ -283,4 +2592,5 @@ int main() {
     }
 
     return 0;
-}
\ No newline at end of file
+}
+#endif
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <string>
+#include <system_error>
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "shm_ring.h"
+
+constexpr uint32_t SHM_CLIENT_RING = 256 * 1024;  // 默认每个方向的环大小
+constexpr int SHM_CLIENT_SPIN = 2000;             // 睡眠前先自旋检查的次数，0 表示直接睡
+
+// 共享内存传输的客户端（单线程使用）：send/recv 的语义和阻塞 socket 一样
+// 环里有数据/有空间时不进内核；需要等待时先自旋一会儿，再挂上 waiting 标记睡在自己的 eventfd 上，
+// 同时盯着控制连接，服务器断开时抛出异常而不是一直睡下去
+class ShmClient {
+private:
+    ShmChannel channel;
+    int control_fd = -1;        // 握手用的 Unix 连接，会话期间保持打开
+    int notify_fd = -1;         // 自己的 eventfd，服务器写它叫醒客户端
+    int server_notify_fd = -1;  // 服务器的 eventfd
+    int spin = SHM_CLIENT_SPIN;
+    uint64_t signals = 0;       // 叫醒服务器的次数
+    uint64_t sleeps = 0;        // 睡在 eventfd 上的次数
+
+    void signal_server() {
+        uint64_t one = 1;
+        ssize_t ret = write(server_notify_fd, &one, sizeof(one));
+        (void)ret;
+        ++signals;
+    }
+
+    // 等到 ready() 为真：先自旋，再用 prepare_wait 挂上 waiting 标记后睡眠
+    template <typename Ready, typename PrepareWait>
+    void wait_until(Ready ready, PrepareWait prepare_wait) {
+        for (int i = 0; i < spin; ++i) {
+            if (ready()) {
+                return;
+            }
+#if defined(__x86_64__) || defined(__i386__)
+            __builtin_ia32_pause();
+#endif
+        }
+        while (!ready()) {
+            if (!prepare_wait()) {
+                continue;
+            }
+            ++sleeps;
+            struct pollfd fds[2] = {{notify_fd, POLLIN, 0}, {control_fd, POLLIN, 0}};
+            if (poll(fds, 2, -1) == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::system_error(errno, std::generic_category(), "poll 失败");
+            }
+            if (fds[1].revents != 0) {
+                throw std::system_error(ECONNRESET, std::generic_category(), "服务器关闭了共享内存会话");
+            }
+            uint64_t count;
+            ssize_t ret = read(notify_fd, &count, sizeof(count));
+            (void)ret;
+        }
+    }
+
+    void close_fds() {
+        for (int* fd : {&control_fd, &notify_fd, &server_notify_fd}) {
+            if (*fd != -1) {
+                close(*fd);
+                *fd = -1;
+            }
+        }
+    }
+
+public:
+    ShmClient() = default;
+    ShmClient(const ShmClient&) = delete;
+    ShmClient& operator=(const ShmClient&) = delete;
+
+    ~ShmClient() { close_fds(); }
+
+    // 连上服务器的握手 socket，建立会话；失败时抛出 std::system_error
+    void connect(const std::string& path, uint32_t ring_size = SHM_CLIENT_RING, int spin_count = SHM_CLIENT_SPIN) {
+        spin = spin_count;
+        int memfd = channel.create(ring_size);
+        notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        server_notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        control_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (notify_fd == -1 || server_notify_fd == -1 || control_fd == -1) {
+            int err = errno;
+            close(memfd);
+            throw std::system_error(err, std::generic_category(), "创建共享内存会话的描述符失败");
+        }
+
+        struct sockaddr_un addr{};
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+        if (::connect(control_fd, (struct sockaddr*)&addr, sizeof(addr)) == -1) {
+            int err = errno;
+            close(memfd);
+            throw std::system_error(err, std::generic_category(), "连接共享内存握手 socket 失败：" + path);
+        }
+
+        // ShmHello + SCM_RIGHTS [memfd, 服务器 eventfd, 客户端 eventfd]
+        ShmHello hello{SHM_MAGIC, SHM_VERSION, ring_size, 0};
+        int fds[SHM_HELLO_FDS] = {memfd, server_notify_fd, notify_fd};
+        struct iovec iov{&hello, sizeof(hello)};
+        alignas(struct cmsghdr) char control_buf[CMSG_SPACE(sizeof(fds))] = {};
+        struct msghdr msg{};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control_buf;
+        msg.msg_controllen = sizeof(control_buf);
+        struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+        memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+        ssize_t sent = sendmsg(control_fd, &msg, MSG_NOSIGNAL);
+        int err = errno;
+        close(memfd);  // 服务器收到的是自己的副本，映射还在
+        if (sent != sizeof(hello)) {
+            throw std::system_error(sent == -1 ? err : EPROTO, std::generic_category(), "发送共享内存握手失败");
+        }
+
+        ShmWelcome welcome{};
+        ssize_t n = recv(control_fd, &welcome, sizeof(welcome), MSG_WAITALL);
+        if (n != sizeof(welcome) || welcome.magic != SHM_MAGIC) {
+            throw std::system_error(n == -1 ? errno : ECONNRESET, std::generic_category(), "共享内存握手没有回应");
+        }
+        if (welcome.status != 0) {
+            throw std::system_error(welcome.status, std::generic_category(), "服务器拒绝了共享内存会话");
+        }
+    }
+
+    // 写完 len 字节，环满时等服务器腾出空间
+    void send_all(const char* data, size_t len) {
+        while (len > 0) {
+            bool wake = false;
+            size_t n = channel.to_server.write(data, len, wake);
+            if (wake) {
+                signal_server();
+            }
+            data += n;
+            len -= n;
+            if (len > 0 && n == 0) {
+                wait_until([this] { return channel.to_server.writable() != 0; },
+                           [this] { return channel.to_server.prepare_write_wait(); });
+            }
+        }
+    }
+
+    // 至少读到 1 个字节才返回，返回读到的字节数
+    size_t recv_some(char* data, size_t len) {
+        wait_until([this] { return channel.to_client.readable() != 0; },
+                   [this] { return channel.to_client.prepare_read_wait(); });
+        bool wake = false;
+        size_t n = channel.to_client.read(data, len, wake);
+        if (wake) {
+            signal_server();
+        }
+        return n;
+    }
+
+    void recv_all(char* data, size_t len) {
+        while (len > 0) {
+            size_t n = recv_some(data, len);
+            data += n;
+            len -= n;
+        }
+    }
+
+    // 发出 len 字节的请求并收齐同样长度的回声：边发边收，消息比两个环加起来还大也不会双方都写满互相等待
+    void exchange(const char* request, char* reply, size_t len) {
+        size_t sent = 0;
+        size_t received = 0;
+        while (received < len) {
+            bool wake = false;
+            size_t progress = 0;
+            if (sent < len) {
+                size_t n = channel.to_server.write(request + sent, len - sent, wake);
+                sent += n;
+                progress += n;
+            }
+            size_t n = channel.to_client.read(reply + received, len - received, wake);
+            received += n;
+            progress += n;
+            if (wake) {
+                signal_server();
+            }
+            if (progress == 0) {
+                // 发不出去也收不到：两个条件都挂上 waiting 标记再睡
+                wait_until(
+                    [&] { return channel.to_client.readable() != 0 || (sent < len && channel.to_server.writable() != 0); },
+                    [&] {
+                        bool write_idle = sent == len || channel.to_server.prepare_write_wait();
+                        return channel.to_client.prepare_read_wait() && write_idle;
+                    });
+            }
+        }
+    }
+
+    uint64_t get_signals() const { return signals; }
+    uint64_t get_sleeps() const { return sleeps; }
+};
@@ -0,0 +1,276 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <system_error>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// 同机共享内存传输：客户端和服务器映射同一个 memfd，里面每个方向一个单生产者/单消费者字节环
+// 数据只在用户态拷贝一次（写进环 / 从环里读出），不经过内核
+// 一方读空（或写满）准备睡眠时在环里挂上 waiting 标记，另一方推进位置后看到标记才写对方的 eventfd 叫醒它，
+// 双方都在忙的时候收发不需要任何系统调用
+//
+// 建立过程：客户端创建 memfd 和两个 eventfd，连上服务器的 Unix socket，发 ShmHello 并用 SCM_RIGHTS
+// 附带 [memfd, 服务器用的 eventfd, 客户端用的 eventfd]；服务器检查后回 ShmWelcome
+// 这条 Unix 连接保持到会话结束，任何一方关闭它（或进程退出）对方都能从 epoll 上感知到
+
+constexpr uint32_t SHM_MAGIC = 0x4d485345;  // "ESHM"
+constexpr uint32_t SHM_VERSION = 1;
+constexpr size_t SHM_HEADER_SIZE = 4096;    // 文件开头放控制信息，两个环的数据区从这之后开始
+constexpr uint32_t SHM_RING_MIN = 4096;
+constexpr uint32_t SHM_RING_MAX = 64 * 1024 * 1024;
+constexpr int SHM_HELLO_FDS = 3;            // 握手消息附带的描述符个数
+
+// 环的一端：生产者和消费者各占一个 cache line，互相只读对方的那一行
+struct alignas(64) ShmCursor {
+    std::atomic<uint64_t> position;  // 累计写入（生产者）/ 读出（消费者）的字节数
+    std::atomic<uint32_t> waiting;   // 该端准备睡眠：生产者表示环满在等空间，消费者表示环空在等数据
+};
+
+struct ShmRingHeader {
+    ShmCursor head;  // 生产者
+    ShmCursor tail;  // 消费者
+};
+
+// memfd 开头的控制信息，由客户端初始化
+struct ShmChannelHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_size;  // 每个环的字节数（2 的幂）
+    uint32_t reserved;
+    alignas(64) ShmRingHeader to_server;  // 客户端 → 服务器
+    ShmRingHeader to_client;              // 服务器 → 客户端
+};
+
+static_assert(sizeof(ShmChannelHeader) <= SHM_HEADER_SIZE);
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "跨进程共享的原子变量必须是无锁的");
+
+// 握手：客户端 → 服务器（附带描述符）
+struct ShmHello {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t ring_size;
+    uint32_t reserved;
+};
+
+// 握手：服务器 → 客户端，status 为 0 表示接受，否则是拒绝原因（errno）
+struct ShmWelcome {
+    uint32_t magic;
+    int32_t status;
+};
+
+inline size_t shm_channel_size(uint32_t ring_size) {
+    return SHM_HEADER_SIZE + 2 * static_cast<size_t>(ring_size);
+}
+
+inline bool shm_valid_ring_size(uint32_t ring_size) {
+    return ring_size >= SHM_RING_MIN && ring_size <= SHM_RING_MAX && (ring_size & (ring_size - 1)) == 0;
+}
+
+// 一个方向的字节环（不持有内存）
+// 位置只增不减，下标取低位；对端把位置写坏时可读/可写量被限制在环容量以内，最多读到错乱的数据，不会越界
+// 睡眠/唤醒用的是 Dekker 式的握手：一方先挂 waiting 再复查对方的位置，另一方先推进位置再查 waiting，
+// 两边都用 seq_cst，不会出现"数据已写入但双方都以为对方会处理"的丢失唤醒
+class ShmRing {
+private:
+    ShmRingHeader* header = nullptr;
+    char* data = nullptr;
+    uint64_t size = 0;
+
+public:
+    ShmRing() = default;
+    ShmRing(ShmRingHeader* ring_header, char* ring_data, uint32_t ring_size)
+        : header(ring_header), data(ring_data), size(ring_size) {}
+
+    // 消费者：可读字节数
+    size_t readable() const {
+        uint64_t head = header->head.position.load(std::memory_order_seq_cst);
+        uint64_t tail = header->tail.position.load(std::memory_order_relaxed);
+        return static_cast<size_t>(std::min(head - tail, size));
+    }
+
+    // 生产者：可写字节数
+    size_t writable() const {
+        uint64_t head = header->head.position.load(std::memory_order_relaxed);
+        uint64_t tail = header->tail.position.load(std::memory_order_seq_cst);
+        return static_cast<size_t>(size - std::min(head - tail, size));
+    }
+
+    // 消费者：从读位置开始连续可读的一段（环尾绕回的部分要等 consume 之后再取）
+    const char* read_span(size_t& len) const {
+        uint64_t tail = header->tail.position.load(std::memory_order_relaxed);
+        size_t offset = static_cast<size_t>(tail & (size - 1));
+        len = std::min(readable(), static_cast<size_t>(size) - offset);
+        return data + offset;
+    }
+
+    // 消费者：释放 len 字节的空间，生产者正在等空间时返回 true（调用方负责叫醒它）
+    bool consume(size_t len) {
+        uint64_t tail = header->tail.position.load(std::memory_order_relaxed);
+        header->tail.position.store(tail + len, std::memory_order_seq_cst);
+        return header->head.waiting.load(std::memory_order_seq_cst) != 0 &&
+               header->head.waiting.exchange(0, std::memory_order_seq_cst) != 0;
+    }
+
+    // 生产者：写入尽可能多的数据，返回写入的字节数；消费者正在等数据时把 wake_peer 置为 true
+    size_t write(const char* src, size_t len, bool& wake_peer) {
+        len = std::min(len, writable());
+        if (len == 0) {
+            return 0;
+        }
+        uint64_t head = header->head.position.load(std::memory_order_relaxed);
+        size_t offset = static_cast<size_t>(head & (size - 1));
+        size_t first = std::min(len, static_cast<size_t>(size) - offset);
+        memcpy(data + offset, src, first);
+        memcpy(data, src + first, len - first);
+        header->head.position.store(head + len, std::memory_order_seq_cst);
+        if (header->tail.waiting.load(std::memory_order_seq_cst) != 0 &&
+            header->tail.waiting.exchange(0, std::memory_order_seq_cst) != 0) {
+            wake_peer = true;
+        }
+        return len;
+    }
+
+    // 消费者：读出最多 len 字节，返回读出的字节数；生产者正在等空间时把 wake_peer 置为 true
+    size_t read(char* dst, size_t len, bool& wake_peer) {
+        size_t total = 0;
+        while (total < len) {
+            size_t span_len;
+            const char* span = read_span(span_len);
+            span_len = std::min(span_len, len - total);
+            if (span_len == 0) {
+                break;
+            }
+            memcpy(dst + total, span, span_len);
+            total += span_len;
+            wake_peer = consume(span_len) || wake_peer;
+        }
+        return total;
+    }
+
+    // 消费者准备睡眠：挂上 waiting 后复查，期间有新数据到达就撤销并返回 false（不能睡）
+    bool prepare_read_wait() {
+        header->tail.waiting.store(1, std::memory_order_seq_cst);
+        if (readable() != 0) {
+            header->tail.waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // 生产者准备睡眠：环满时挂上 waiting 后复查，期间消费者腾出了空间就撤销并返回 false
+    bool prepare_write_wait() {
+        header->head.waiting.store(1, std::memory_order_seq_cst);
+        if (writable() != 0) {
+            header->head.waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+};
+
+// memfd 的映射：客户端 create 新建并初始化，服务器 attach 收到的描述符
+class ShmChannel {
+private:
+    void* base = nullptr;
+    size_t length = 0;
+    uint32_t ring_size = 0;
+
+    void map(int fd, size_t size) {
+        void* addr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "映射共享内存失败");
+        }
+        base = addr;
+        length = size;
+    }
+
+    ShmChannelHeader* header() const { return static_cast<ShmChannelHeader*>(base); }
+    char* ring_data(int index) const {
+        return static_cast<char*>(base) + SHM_HEADER_SIZE + static_cast<size_t>(index) * ring_size;
+    }
+
+public:
+    ShmRing to_server;  // 客户端写，服务器读
+    ShmRing to_client;  // 服务器写，客户端读
+
+    ShmChannel() = default;
+    ShmChannel(const ShmChannel&) = delete;
+    ShmChannel& operator=(const ShmChannel&) = delete;
+
+    ~ShmChannel() {
+        if (base != nullptr) {
+            munmap(base, length);
+        }
+    }
+
+    // 客户端：创建 memfd 并初始化控制信息，返回 memfd（调用方负责传给服务器后关闭）
+    // 文件大小用 seal 锁死，服务器不用担心客户端事后截断文件导致访问映射时 SIGBUS
+    int create(uint32_t size) {
+        if (!shm_valid_ring_size(size)) {
+            throw std::invalid_argument("共享内存环的大小必须是 4K ~ 64M 之间的 2 的幂");
+        }
+        int fd = memfd_create("echo_shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "memfd_create 失败");
+        }
+        ring_size = size;
+        if (ftruncate(fd, static_cast<off_t>(shm_channel_size(size))) == -1 ||
+            fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_SEAL) == -1) {
+            int err = errno;
+            close(fd);
+            throw std::system_error(err, std::generic_category(), "设置共享内存大小失败");
+        }
+        try {
+            map(fd, shm_channel_size(size));
+        } catch (...) {
+            close(fd);
+            throw;
+        }
+        // 新建的 memfd 全是 0，原子变量的初始值正好是 0
+        ShmChannelHeader* h = header();
+        h->magic = SHM_MAGIC;
+        h->version = SHM_VERSION;
+        h->ring_size = size;
+        to_server = ShmRing(&h->to_server, ring_data(0), size);
+        to_client = ShmRing(&h->to_client, ring_data(1), size);
+        return fd;
+    }
+
+    // 服务器：映射客户端传来的 memfd，检查大小、seal 和控制信息，不合法时抛出 std::system_error
+    // 之后只按握手时约定的 ring_size 访问，不再读控制信息里客户端能改的字段
+    void attach(int fd, uint32_t size) {
+        if (!shm_valid_ring_size(size)) {
+            throw std::system_error(EINVAL, std::generic_category(), "共享内存环大小不合法");
+        }
+        struct stat st;
+        if (fstat(fd, &st) == -1) {
+            throw std::system_error(errno, std::generic_category(), "fstat 共享内存失败");
+        }
+        int seals = fcntl(fd, F_GET_SEALS);
+        if (seals == -1 || (seals & F_SEAL_SHRINK) == 0) {
+            throw std::system_error(EPERM, std::generic_category(), "共享内存没有禁止缩小的 seal");
+        }
+        if (static_cast<size_t>(st.st_size) != shm_channel_size(size)) {
+            throw std::system_error(EINVAL, std::generic_category(), "共享内存大小和握手不一致");
+        }
+        ring_size = size;
+        map(fd, shm_channel_size(size));
+        ShmChannelHeader* h = header();
+        if (h->magic != SHM_MAGIC || h->version != SHM_VERSION || h->ring_size != size) {
+            throw std::system_error(EPROTO, std::generic_category(), "共享内存控制信息不匹配");
+        }
+        to_server = ShmRing(&h->to_server, ring_data(0), size);
+        to_client = ShmRing(&h->to_client, ring_data(1), size);
+    }
+
+    uint32_t get_ring_size() const { return ring_size; }
+};
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <system_error>
+#include <cstring>
+#include <cerrno>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+// socket 调优参数（按监听 socket 配置，accept 出来的连接使用同一套参数）
+// 数值类参数为 0 表示不设置、沿用内核默认值
+struct SocketProfile {
+    std::string name;
+    bool nodelay = false;        // TCP_NODELAY：关闭 Nagle，小回复立即发出
+    bool cork = false;           // 一次写事件要发多个块时用 TCP_CORK 攒成整包，发完再解除
+    bool keepalive = false;      // SO_KEEPALIVE：探测失效的空闲连接
+    int keepalive_idle = 60;     // TCP_KEEPIDLE（秒）
+    int keepalive_interval = 10; // TCP_KEEPINTVL（秒）
+    int keepalive_count = 5;     // TCP_KEEPCNT
+    int sndbuf = 0;              // SO_SNDBUF（字节）
+    int rcvbuf = 0;              // SO_RCVBUF（字节），在 listen 前设置才能影响窗口扩大因子
+    int defer_accept = 0;        // TCP_DEFER_ACCEPT（秒）：连接上有数据才唤醒 accept
+    int fastopen = 0;            // TCP_FASTOPEN：TFO 请求队列长度
+};
+
+// 内置配置
+//   none       ：不做任何调优（默认，旧版行为）
+//   latency    ：关闭 Nagle + TFO，适合小消息请求/应答，需要用 --socket-profile=latency 显式开启
+//   throughput ：大缓冲区 + cork 批量发送 + 延迟 accept，适合大块数据
+inline SocketProfile make_socket_profile(std::string_view name) {
+    SocketProfile profile;
+    profile.name = std::string(name);
+    if (name == "none") {
+        return profile;
+    }
+    if (name == "latency") {
+        profile.nodelay = true;
+        profile.fastopen = 256;
+        return profile;
+    }
+    if (name == "throughput") {
+        profile.nodelay = true;
+        profile.cork = true;
+        profile.keepalive = true;
+        profile.sndbuf = 4 * 1024 * 1024;
+        profile.rcvbuf = 4 * 1024 * 1024;
+        profile.defer_accept = 1;
+        profile.fastopen = 256;
+        return profile;
+    }
+    throw std::invalid_argument("未知的 socket 配置：" + std::string(name) + "（可选 none|latency|throughput）");
+}
+
+// 解析单项覆盖参数（--tcp-nodelay=0|1 等），不是 socket 参数时返回 false
+inline bool parse_socket_option(std::string_view arg, SocketProfile& profile) {
+    size_t eq = arg.find('=');
+    if (eq == std::string_view::npos) {
+        return false;
+    }
+    std::string_view key = arg.substr(0, eq);
+    std::string value(arg.substr(eq + 1));
+    if (key == "--socket-profile") {
+        profile = make_socket_profile(value);
+    } else if (key == "--tcp-nodelay") {
+        profile.nodelay = std::stoi(value) != 0;
+    } else if (key == "--tcp-cork") {
+        profile.cork = std::stoi(value) != 0;
+    } else if (key == "--keepalive") {
+        profile.keepalive = std::stoi(value) != 0;
+    } else if (key == "--sndbuf") {
+        profile.sndbuf = std::stoi(value);
+    } else if (key == "--rcvbuf") {
+        profile.rcvbuf = std::stoi(value);
+    } else if (key == "--tcp-defer-accept") {
+        profile.defer_accept = std::stoi(value);
+    } else if (key == "--tcp-fastopen") {
+        profile.fastopen = std::stoi(value);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline void print_socket_profile(const SocketProfile& profile) {
+    std::cout << "socket 配置：" << profile.name
+              << "（nodelay=" << profile.nodelay << " cork=" << profile.cork
+              << " keepalive=" << profile.keepalive
+              << " sndbuf=" << profile.sndbuf << " rcvbuf=" << profile.rcvbuf
+              << " defer_accept=" << profile.defer_accept << " fastopen=" << profile.fastopen << "）" << std::endl;
+}
+
+inline int set_int_option(int fd, int level, int option, int value) {
+    return setsockopt(fd, level, option, &value, sizeof(value));
+}
+
+// 监听 socket 的选项（bind 之前调用），失败抛出 std::system_error
+// 每个选项单独调用一次 setsockopt：选项编号不是位掩码，不能按位或到一起
+inline void apply_listener_options(int fd, const SocketProfile& profile) {
+    if (set_int_option(fd, SOL_SOCKET, SO_REUSEADDR, 1) == -1) {
+        throw std::system_error(errno, std::generic_category(), "setsockopt SO_REUSEADDR 失败");
+    }
+    if (set_int_option(fd, SOL_SOCKET, SO_REUSEPORT, 1) == -1) {
+        throw std::system_error(errno, std::generic_category(), "setsockopt SO_REUSEPORT 失败");
+    }
+    // 缓冲区大小会被 accept 出来的连接继承
+    if (profile.rcvbuf > 0 && set_int_option(fd, SOL_SOCKET, SO_RCVBUF, profile.rcvbuf) == -1) {
+        throw std::system_error(errno, std::generic_category(), "setsockopt SO_RCVBUF 失败");
+    }
+    if (profile.sndbuf > 0 && set_int_option(fd, SOL_SOCKET, SO_SNDBUF, profile.sndbuf) == -1) {
+        throw std::system_error(errno, std::generic_category(), "setsockopt SO_SNDBUF 失败");
+    }
+    if (profile.defer_accept > 0 && set_int_option(fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, profile.defer_accept) == -1) {
+        throw std::system_error(errno, std::generic_category(), "setsockopt TCP_DEFER_ACCEPT 失败");
+    }
+    // TFO 依赖 net.ipv4.tcp_fastopen 的服务端开关，内核不支持时只告警
+    if (profile.fastopen > 0 && set_int_option(fd, IPPROTO_TCP, TCP_FASTOPEN, profile.fastopen) == -1) {
+        std::cerr << "setsockopt TCP_FASTOPEN 失败：" << std::strerror(errno) << std::endl;
+    }
+}
+
+// 已建立连接的选项（accept 之后或 connect 之前调用），失败只告警不断开连接
+inline void apply_connection_options(int fd, const SocketProfile& profile) {
+    auto warn = [](const char* option) {
+        std::cerr << "setsockopt " << option << " 失败：" << std::strerror(errno) << std::endl;
+    };
+    if (profile.nodelay && set_int_option(fd, IPPROTO_TCP, TCP_NODELAY, 1) == -1) {
+        warn("TCP_NODELAY");
+    }
+    if (profile.keepalive) {
+        if (set_int_option(fd, SOL_SOCKET, SO_KEEPALIVE, 1) == -1 ||
+            set_int_option(fd, IPPROTO_TCP, TCP_KEEPIDLE, profile.keepalive_idle) == -1 ||
+            set_int_option(fd, IPPROTO_TCP, TCP_KEEPINTVL, profile.keepalive_interval) == -1 ||
+            set_int_option(fd, IPPROTO_TCP, TCP_KEEPCNT, profile.keepalive_count) == -1) {
+            warn("keepalive");
+        }
+    }
+}
+
+// 打开/解除 TCP_CORK：解除时内核立即把攒着的数据发出去
+inline void set_cork(int fd, bool on) {
+    set_int_option(fd, IPPROTO_TCP, TCP_CORK, on ? 1 : 0);
+}
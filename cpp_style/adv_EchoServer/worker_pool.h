@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <memory>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "lockfree_queue.h"
+
+// 交给 worker 线程处理的请求
+// reactor 填写 owner/seq/request，worker 填写 result；worker 不碰 owner，也不访问缓冲池
+struct OffloadTask {
+    void* owner = nullptr;           // 提交请求的连接
+    uint64_t seq = 0;                // 请求在该连接内的序号（用于按顺序回复）
+    std::string request;             // 请求内容（一行，不含换行符）
+    std::string result;              // 处理结果
+    OffloadTask* next = nullptr;     // 结果队列的链表指针
+};
+
+using TaskHandler = void (*)(OffloadTask* task);
+
+// CPU 密集型请求的线程池
+// reactor → worker：每个 worker 一个 SPSC 队列 + 一个 eventfd（worker 空闲睡眠时才需要唤醒）
+// worker → reactor：共用一个 MPSC 队列 + 一个注册在 reactor epoll 里的 eventfd
+// reactor 线程上的操作（submit/take_results）都不加锁
+class WorkerPool {
+private:
+    struct Worker {
+        SpscQueue<OffloadTask*> queue;
+        int wake_fd;                         // worker 睡眠时阻塞在这个 eventfd 上
+        std::atomic<bool> sleeping{false};   // worker 即将或已经阻塞在 wake_fd 上
+        std::thread thread;
+
+        explicit Worker(size_t capacity) : queue(capacity), wake_fd(-1) {}
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    MpscQueue<OffloadTask> results;
+    int notify_fd;           // 有结果时通知 reactor
+    TaskHandler handler;
+    size_t next_worker = 0;  // 轮询分发的下一个 worker
+    std::atomic<bool> stopping{false};
+
+    static void signal_eventfd(int fd) {
+        uint64_t one = 1;
+        ssize_t ret = write(fd, &one, sizeof(one));
+        (void)ret;  // 计数器溢出前对端总会读走，失败可以忽略
+    }
+
+    void worker_loop(Worker* worker) {
+        while (!stopping.load(std::memory_order_relaxed)) {
+            OffloadTask* task;
+            bool produced = false;
+            while (worker->queue.pop(task)) {
+                handler(task);
+                results.push(task);
+                produced = true;
+            }
+            // 一批处理完再通知一次，减少 eventfd 写入次数
+            if (produced) {
+                signal_eventfd(notify_fd);
+            }
+
+            // 先声明要睡眠再检查队列；和 submit 里"先入队再检查 sleeping"配对，保证不会漏掉唤醒
+            worker->sleeping.store(true, std::memory_order_seq_cst);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!worker->queue.empty()) {
+                worker->sleeping.store(false, std::memory_order_relaxed);
+                continue;
+            }
+            uint64_t count;
+            ssize_t ret = read(worker->wake_fd, &count, sizeof(count));
+            (void)ret;
+            worker->sleeping.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // 停掉已经启动的 worker 并关闭 eventfd；析构和构造失败时共用，只处理已经创建出来的部分
+    void shutdown() {
+        stopping.store(true);
+        for (auto& worker : workers) {
+            if (worker->thread.joinable()) {
+                signal_eventfd(worker->wake_fd);
+                worker->thread.join();
+            }
+            if (worker->wake_fd != -1) {
+                close(worker->wake_fd);
+            }
+        }
+        if (notify_fd != -1) {
+            close(notify_fd);
+        }
+    }
+
+public:
+    // 创建 eventfd 或启动线程中途失败时，先停掉已经启动的线程再抛出（joinable 的 std::thread 被析构会 terminate）
+    WorkerPool(size_t worker_count, size_t queue_capacity, TaskHandler handler) : handler(handler) {
+        notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (notify_fd == -1) {
+            throw std::system_error(errno, std::generic_category(), "eventfd 创建失败");
+        }
+        try {
+            workers.reserve(worker_count);
+            for (size_t i = 0; i < worker_count; ++i) {
+                // 先放进 workers 再启动线程，失败时 shutdown 能找到它
+                workers.push_back(std::make_unique<Worker>(queue_capacity));
+                Worker* worker = workers.back().get();
+                worker->wake_fd = eventfd(0, EFD_CLOEXEC);
+                if (worker->wake_fd == -1) {
+                    throw std::system_error(errno, std::generic_category(), "eventfd 创建失败");
+                }
+                worker->thread = std::thread(&WorkerPool::worker_loop, this, worker);
+            }
+        } catch (...) {
+            shutdown();
+            throw;
+        }
+    }
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool& operator=(const WorkerPool&) = delete;
+
+    ~WorkerPool() { shutdown(); }
+
+    // reactor 在 epoll 中监听这个 fd，可读表示有处理完的结果
+    int get_notify_fd() const { return notify_fd; }
+    size_t get_worker_count() const { return workers.size(); }
+
+    // 轮询分发给 worker，所有 worker 的队列都满时返回 false（调用方自行处理）
+    bool submit(OffloadTask* task) {
+        for (size_t tries = 0; tries < workers.size(); ++tries) {
+            Worker* worker = workers[next_worker].get();
+            next_worker = (next_worker + 1) % workers.size();
+            if (!worker->queue.push(task)) {
+                continue;
+            }
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (worker->sleeping.load(std::memory_order_seq_cst)) {
+                signal_eventfd(worker->wake_fd);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    // 清掉 eventfd 计数并取走所有结果（按每个 worker 的完成顺序链接）
+    OffloadTask* take_results() {
+        uint64_t count;
+        ssize_t ret = read(notify_fd, &count, sizeof(count));
+        (void)ret;
+        return results.pop_all();
+    }
+};